@@ -33,8 +33,10 @@ struct ionic_lif;
 
 extern bool port_init_up;
 extern unsigned int rx_copybreak;
+extern bool rx_copybreak_adaptive;
 extern unsigned int rx_fill_threshold;
 extern unsigned int tx_budget;
+extern unsigned int tx_dbell_batch;
 extern unsigned int devcmd_timeout;
 extern unsigned long affinity_mask_override;
 
@@ -66,6 +68,8 @@ struct ionic {
 	unsigned int nrdma_eqs_per_lif;
 	unsigned int ntxqs_per_lif;
 	unsigned int nrxqs_per_lif;
+	unsigned int nhwstamp_txqs_per_lif;
+	unsigned int nxdp_txqs_per_lif;
 	unsigned int nlifs;
 	DECLARE_BITMAP(lifbits, IONIC_LIFS_MAX);
 	DECLARE_BITMAP(ethbits, IONIC_LIFS_MAX);
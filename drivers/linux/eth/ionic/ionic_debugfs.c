@@ -167,6 +167,10 @@ void ionic_debugfs_add_sizes(struct ionic *ionic)
 			   (u32 *)&ionic->ident.lif.eth.config.queue_count[IONIC_QTYPE_TXQ]);
 	debugfs_create_u32("nrxqs_per_lif", 0400, ionic->dentry,
 			   (u32 *)&ionic->ident.lif.eth.config.queue_count[IONIC_QTYPE_RXQ]);
+	debugfs_create_u32("nhwstamp_txqs_per_lif", 0400, ionic->dentry,
+			   &ionic->nhwstamp_txqs_per_lif);
+	debugfs_create_u32("nxdp_txqs_per_lif", 0400, ionic->dentry,
+			   &ionic->nxdp_txqs_per_lif);
 }
 
 static int q_tail_show(struct seq_file *seq, void *v)
@@ -199,6 +203,24 @@ static int cq_tail_show(struct seq_file *seq, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(cq_tail);
 
+static int q_size_hist_show(struct seq_file *seq, void *v)
+{
+	struct ionic_queue *q = seq->private;
+	struct ionic_rx_stats *stats = q_to_rx_stats(q);
+	unsigned int i;
+
+	for (i = 0; i < IONIC_RX_SIZE_BUCKETS - 1; i++)
+		seq_printf(seq, "<=%-5lu %llu\n",
+			   BIT(IONIC_RX_SIZE_BUCKET_SHIFT + i),
+			   stats->size_hist[i]);
+	seq_printf(seq, ">%-6lu %llu\n",
+		   BIT(IONIC_RX_SIZE_BUCKET_SHIFT + i - 1),
+		   stats->size_hist[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(q_size_hist);
+
 static const struct debugfs_reg32 intr_ctrl_regs[] = {
 	{ .name = "coal_init", .offset = 0, },
 	{ .name = "mask", .offset = 4, },
@@ -210,7 +232,7 @@ static const struct debugfs_reg32 intr_ctrl_regs[] = {
 void ionic_debugfs_add_qcq(struct ionic_lif *lif, struct ionic_qcq *qcq)
 {
 	struct dentry *qcq_dentry, *q_dentry, *cq_dentry;
-	struct dentry *intr_dentry, *stats_dentry;
+	struct dentry *intr_dentry, *stats_dentry, *cb_dentry;
 	struct ionic_dev *idev = &lif->ionic->idev;
 	struct debugfs_regset32 *intr_ctrl_regset;
 	struct ionic_intr_info *intr = &qcq->intr;
@@ -254,6 +276,9 @@ void ionic_debugfs_add_qcq(struct ionic_lif *lif, struct ionic_qcq *qcq)
 	debugfs_create_u64("drop", 0400, q_dentry, &q->drop);
 	debugfs_create_u64("stop", 0400, q_dentry, &q->stop);
 	debugfs_create_u64("wake", 0400, q_dentry, &q->wake);
+	if (q->type == IONIC_QTYPE_RXQ)
+		debugfs_create_u32("fill_threshold", 0400, q_dentry,
+				   &q->fill_threshold);
 
 	debugfs_create_file("tail", 0400, q_dentry, q, &q_tail_fops);
 	debugfs_create_file("head", 0400, q_dentry, q, &q_head_fops);
@@ -291,6 +316,12 @@ void ionic_debugfs_add_qcq(struct ionic_lif *lif, struct ionic_qcq *qcq)
 				   &txqstats[q->index].clean);
 		debugfs_create_u64("linearize", 0400, stats_dentry,
 				   &txqstats[q->index].linearize);
+		debugfs_create_u64("frag_pack", 0400, stats_dentry,
+				   &txqstats[q->index].frag_pack);
+		debugfs_create_u64("frag_copy_bytes", 0400, stats_dentry,
+				   &txqstats[q->index].frag_copy_bytes);
+		debugfs_create_u64("frag_zc_bytes", 0400, stats_dentry,
+				   &txqstats[q->index].frag_zc_bytes);
 		debugfs_create_u64("csum_none", 0400, stats_dentry,
 				   &txqstats[q->index].csum_none);
 		debugfs_create_u64("csum", 0400, stats_dentry,
@@ -325,6 +356,26 @@ void ionic_debugfs_add_qcq(struct ionic_lif *lif, struct ionic_qcq *qcq)
 				   &rxqstats[q->index].csum_error);
 	}
 
+	if (q->type == IONIC_QTYPE_RXQ) {
+		cb_dentry = debugfs_create_dir("copybreak", q_dentry);
+		if (IS_ERR_OR_NULL(cb_dentry))
+			return;
+
+		debugfs_create_u32("value", 0600, cb_dentry,
+				   &q->copybreak.value);
+		debugfs_create_u32("ceiling", 0600, cb_dentry,
+				   &q->copybreak.ceiling);
+#if (RHEL_RELEASE_CODE && (RHEL_RELEASE_VERSION(7, 0) < RHEL_RELEASE_CODE))
+		debugfs_create_u8("adaptive", 0600, cb_dentry,
+				  (u8 *)&q->copybreak.adaptive);
+#else
+		debugfs_create_bool("adaptive", 0600, cb_dentry,
+				    &q->copybreak.adaptive);
+#endif
+		debugfs_create_file("size_hist", 0400, cb_dentry, q,
+				    &q_size_hist_fops);
+	}
+
 	cq_dentry = debugfs_create_dir("cq", qcq->dentry);
 	if (IS_ERR_OR_NULL(cq_dentry))
 		return;
@@ -359,6 +410,10 @@ void ionic_debugfs_add_qcq(struct ionic_lif *lif, struct ionic_qcq *qcq)
 				   &intr->vector);
 		debugfs_create_u32("dim_coal_hw", 0400, intr_dentry,
 				   &intr->dim_coal_hw);
+		debugfs_create_u8("dim_profile_ix", 0400, intr_dentry,
+				  &qcq->dim.profile_ix);
+		debugfs_create_u64("dim_transitions", 0400, intr_dentry,
+				   &intr->dim_transitions);
 
 		intr_ctrl_regset = devm_kzalloc(dev, sizeof(*intr_ctrl_regset),
 						GFP_KERNEL);
@@ -516,6 +571,84 @@ static int lif_n_txrx_alloc_show(struct seq_file *seq, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(lif_n_txrx_alloc);
 
+static int lif_xps_show(struct seq_file *seq, void *v)
+{
+	struct ionic_lif *lif = seq->private;
+	struct ionic_qcq *qcq;
+	unsigned int i;
+
+	mutex_lock(&lif->queue_lock);
+	if (!lif->txqcqs || !lif->rxqcqs)
+		goto out;
+
+	seq_puts(seq, "txq  intr  cpus\n");
+	for (i = 0; i < lif->nxqs; i++) {
+		if (test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state))
+			qcq = lif->txqcqs[i];
+		else
+			qcq = lif->rxqcqs[i];
+		if (!qcq)
+			break;
+
+		seq_printf(seq, "%-4u %-5u %*pbl\n", i, qcq->intr.index,
+			   cpumask_pr_args(&qcq->intr.affinity_mask));
+	}
+out:
+	mutex_unlock(&lif->queue_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lif_xps);
+
+static int lif_dim_profiles_show(struct seq_file *seq, void *v)
+{
+	struct ionic_lif *lif = seq->private;
+	int i;
+
+	seq_puts(seq, "ix  rx_hw  tx_hw\n");
+	for (i = 0; i < IONIC_DIM_NUM_PROFILES; i++)
+		seq_printf(seq, "%-3d %-6u %u\n", i,
+			   lif->dim_rx_hw[i], lif->dim_tx_hw[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lif_dim_profiles);
+
+static int lif_intr_mode_show(struct seq_file *seq, void *v)
+{
+	struct ionic_lif *lif = seq->private;
+	struct ionic_qpair_rate *qr;
+	unsigned int i;
+
+	mutex_lock(&lif->queue_lock);
+
+	seq_printf(seq, "auto: %s  wanted: %s  switches: %llu\n",
+		   test_bit(IONIC_LIF_F_AUTO_SPLIT_INTR, lif->state) ?
+			"on" : "off",
+		   lif->intr_auto_split ? "split" : "shared",
+		   lif->intr_auto_switches);
+
+	if (!lif->txqcqs || !lif->qpair_rates)
+		goto out;
+
+	seq_puts(seq, "qp   mode    tx_pps     rx_pps\n");
+	for (i = 0; i < lif->nxqs; i++) {
+		if (!lif->txqcqs[i])
+			break;
+
+		qr = &lif->qpair_rates[i];
+		seq_printf(seq, "%-4u %-7s %-10llu %llu\n", i,
+			   lif->txqcqs[i]->flags & IONIC_QCQ_F_INTR ?
+				"split" : "shared",
+			   qr->tx_pps, qr->rx_pps);
+	}
+out:
+	mutex_unlock(&lif->queue_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lif_intr_mode);
+
 void ionic_debugfs_add_lif(struct ionic_lif *lif)
 {
 	struct dentry *lif_dentry;
@@ -535,6 +668,14 @@ void ionic_debugfs_add_lif(struct ionic_lif *lif)
 			    lif, &lif_filters_fops);
 	debugfs_create_file("txrx_alloc", 0400, lif->dentry,
 			    lif, &lif_n_txrx_alloc_fops);
+	debugfs_create_file("xps", 0400, lif->dentry,
+			    lif, &lif_xps_fops);
+	debugfs_create_file("dim_profiles", 0400, lif->dentry,
+			    lif, &lif_dim_profiles_fops);
+	debugfs_create_u64("dbell_sweep_kicks", 0400, lif->dentry,
+			   &lif->dbell_sweep_kicks);
+	debugfs_create_file("intr_mode", 0400, lif->dentry,
+			    lif, &lif_intr_mode_fops);
 }
 
 void ionic_debugfs_del_lif(struct ionic_lif *lif)
@@ -5,6 +5,7 @@
 #define _IONIC_DEV_H_
 
 #include <linux/atomic.h>
+#include <linux/interrupt.h>
 #include <linux/mutex.h>
 #include <linux/workqueue.h>
 
@@ -18,22 +19,58 @@
 #define IONIC_DEF_TXRX_DESC		4096
 #define IONIC_RX_FILL_THRESHOLD	64
 #define IONIC_RX_FILL_DIV		8
+#define IONIC_RX_PREFETCH_AHEAD		4
+#define IONIC_TX_DBELL_BATCH_MAX	64
+#define IONIC_TX_BOUNCE_SZ		256
+#define IONIC_TX_BOUNCE_SLOTS		1024
+#define IONIC_TX_FRAG_PACK_MAX		(4 * PAGE_SIZE)
+#define IONIC_MAX_HWSTAMP_TXQS		4
 #define IONIC_LIFS_MAX			1024
 #define IONIC_WATCHDOG_PCI_SECS		5
 #define IONIC_WATCHDOG_PLAT_MSECS	100
 #define IONIC_HEARTBEAT_SECS		1
 #define IONIC_ITR_COAL_USEC_DEFAULT	8
+#define IONIC_DIM_NUM_PROFILES		5
+#define IONIC_INTR_AUTO_SPLIT_PPS	100000	/* each way, on a queue pair */
+#define IONIC_INTR_AUTO_ACTIVE_PPS	10000
+#define IONIC_INTR_AUTO_QUIET_PPS	1000	/* whole lif */
 
 #define IONIC_DEV_CMD_REG_VERSION	1
 #define IONIC_DEV_INFO_REG_COUNT	32
 #define IONIC_DEV_CMD_REG_COUNT		32
 
-#define IONIC_NAPI_DEADLINE		(HZ / 200)	/* 5ms */
+#define IONIC_NAPI_DEADLINE		max(HZ / 200, 1)	/* 5ms */
 #define IONIC_ADMIN_DOORBELL_DEADLINE	(HZ / 2)	/* 500ms */
 #define IONIC_TX_DOORBELL_DEADLINE	(HZ / 100)	/* 10ms */
 #define IONIC_RX_MIN_DOORBELL_DEADLINE	(HZ / 100)	/* 10ms */
 #define IONIC_RX_MAX_DOORBELL_DEADLINE	(HZ * 5)	/* 5s */
 
+/* native XDP relies on the xdp_features era of the XDP API */
+#ifdef HAVE_XDP_FEATURES
+#define IONIC_XDP
+#if IS_ENABLED(CONFIG_XDP_SOCKETS)
+#define IONIC_XSK
+#endif
+#endif
+
+/* rx buffers come from a page_pool where the kernel has a usable one */
+#if defined(HAVE_PAGE_POOL_HELPERS) && IS_ENABLED(CONFIG_PAGE_POOL)
+#define IONIC_PAGE_POOL
+#if IS_ENABLED(CONFIG_PAGE_POOL_STATS)
+#define IONIC_PAGE_POOL_STATS
+#endif
+#endif
+
+/* multi-buffer XDP hands frag pages to the stack, so wants the page_pool */
+#if defined(IONIC_XDP) && defined(IONIC_PAGE_POOL)
+#define IONIC_XDP_MB
+#endif
+
+/* NETIF_F_GRO_HW is honoured by coalescing TCP segments in the driver */
+#ifdef NETIF_F_GRO_HW
+#define IONIC_GRO_HW
+#endif
+
 struct ionic_dev_bar {
 	void __iomem *vaddr;
 	phys_addr_t bus_addr;
@@ -180,6 +217,12 @@ struct ionic_cq_info {
 struct ionic_queue;
 struct ionic_qcq;
 struct ionic_desc_info;
+struct xdp_frame;
+struct xdp_rxq_info;
+struct bpf_prog;
+struct page_pool;
+struct xsk_buff_pool;
+struct xdp_buff;
 
 typedef void (*ionic_desc_cb)(struct ionic_queue *q,
 			      struct ionic_desc_info *desc_info,
@@ -192,6 +235,50 @@ typedef void (*ionic_desc_cb)(struct ionic_queue *q,
 #define IONIC_PAGE_GFP_MASK			(GFP_ATOMIC | __GFP_NOWARN |\
 						 __GFP_COMP | __GFP_MEMALLOC)
 
+/* Header split: buf[0] is a small buffer that becomes the skb head,
+ * with room in front for NET_SKB_PAD and behind for skb_shared_info.
+ */
+#define IONIC_RX_HDR_SZ				256
+#define IONIC_RX_HDR_BUF_SZ			(SKB_DATA_ALIGN(NET_SKB_PAD + IONIC_RX_HDR_SZ) + \
+						 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
+/* Rx packet size histogram buckets: <=64, <=128, ... <=4096, bigger */
+#define IONIC_RX_SIZE_BUCKET_SHIFT		6
+#define IONIC_RX_SIZE_BUCKETS			8
+
+/* Adaptive copybreak: every IONIC_RX_CB_WINDOW packets the copybreak is
+ * raised to cover IONIC_RX_CB_COVER percent of the packets that fit under
+ * the ceiling when at least IONIC_RX_CB_HIT_HI percent of traffic does,
+ * or dropped to zero when fewer than IONIC_RX_CB_HIT_LO percent do.
+ */
+#define IONIC_RX_CB_WINDOW			1024
+#define IONIC_RX_CB_HIT_HI			50
+#define IONIC_RX_CB_HIT_LO			10
+#define IONIC_RX_CB_COVER			90
+
+struct ionic_rx_copybreak {
+	u32 value;		/* bytes copied into the skb head */
+	u32 ceiling;		/* most the controller will pick */
+	bool adaptive;
+	u32 window;		/* packets seen since the last decision */
+	u64 hist_base[IONIC_RX_SIZE_BUCKETS];
+};
+
+#ifdef IONIC_GRO_HW
+/* Longest Ethernet + IPv6 + TCP header an aggregate is built from */
+#define IONIC_RX_AGG_HDR_MAX			(ETH_HLEN + 40 + 60)
+#define IONIC_RX_AGG_MAX_LEN			0xffff
+
+struct ionic_rx_agg {
+	struct sk_buff *skb;	/* aggregate being built, or NULL */
+	u32 next_seq;		/* TCP sequence number expected next */
+	u16 thoff;		/* TCP header offset from the IP header */
+	u16 hlen;		/* IP + TCP header length */
+	u16 mss;		/* payload length of the first segment */
+	u16 segs;
+};
+#endif
+
 struct ionic_buf_info {
 	struct page *page;
 	dma_addr_t dma_addr;
@@ -199,13 +286,19 @@ struct ionic_buf_info {
 	u32 len;
 };
 
+#ifndef IONIC_PAGE_POOL
 #define IONIC_PAGE_CACHE_SIZE          2048
+#define IONIC_RX_BULK_ALLOC		16
 
 struct ionic_page_cache {
 	u32 head;
 	u32 tail;
 	struct ionic_buf_info ring[IONIC_PAGE_CACHE_SIZE];
+	/* freshly allocated and mapped pages, used before the allocator */
+	u32 bulk_avail;
+	struct ionic_buf_info bulk[IONIC_RX_BULK_ALLOC];
 } ____cacheline_aligned_in_smp;
+#endif
 
 #define IONIC_MAX_FRAGS			(1 + IONIC_TX_MAX_SG_ELEMS_V1)
 
@@ -224,7 +317,18 @@ struct ionic_desc_info {
 	};
 	unsigned int bytes;
 	unsigned int nbufs;
+	bool bounce;		/* tx: bufs[0] is a premapped bounce slot */
+	bool sg_stale;		/* rx: sg ring no longer matches bufs[1..] */
+	u16 head_len;		/* rx: bytes posted in bufs[0] */
+	u16 sg_len;		/* rx: bytes posted in the sg elements */
 	struct ionic_buf_info bufs[IONIC_MAX_FRAGS];
+#ifdef IONIC_XDP
+	struct xdp_frame *xdpf;
+#endif
+#ifdef IONIC_XSK
+	struct xdp_buff *xsk_buf;	/* rx: UMEM frame posted here */
+	bool xsk_tx;			/* tx: frame from the XSK TX ring */
+#endif
 	ionic_desc_cb cb;
 	void *cb_arg;
 };
@@ -240,6 +344,9 @@ struct ionic_queue {
 	unsigned long dbell_jiffies;
 	u16 head_idx;
 	u16 tail_idx;
+	u16 dbell_idx;		/* head_idx as of the last doorbell */
+	u16 dbell_batch;	/* tx descriptors to hold the doorbell for */
+	bool dbell_deferred;	/* tx batching is holding the doorbell */
 	unsigned int index;
 	unsigned int num_descs;
 	unsigned int max_sg_elems;
@@ -252,6 +359,7 @@ struct ionic_queue {
 	u64 depth_max;
 #endif
 	u64 features;
+	spinlock_t hwstamp_lock;	/* hwstamp txq, posted from any CPU */
 	struct ionic_dev *idev;
 	unsigned int type;
 	unsigned int hw_index;
@@ -274,7 +382,30 @@ struct ionic_queue {
 	unsigned int desc_size;
 	unsigned int sg_desc_size;
 	unsigned int pid;
-	struct ionic_page_cache page_cache;
+	bool hdr_split;		/* buf[0] is a header buffer */
+	u32 comp_rate;		/* completions per poll, EWMA x8 */
+	u32 fill_threshold;
+	int node;		/* memory node for rx buffers, follows NAPI */
+	struct ionic_rx_copybreak copybreak;
+#ifdef IONIC_GRO_HW
+	struct ionic_rx_agg agg;
+#endif
+#ifdef IONIC_XDP
+	struct bpf_prog *xdp_prog;
+	struct xdp_rxq_info *xdp_rxq_info;
+	bool xdp_flush;		/* XDP_REDIRECT needs xdp_do_flush() */
+	bool xdp_tx_pending;	/* XDP_TX frames posted, doorbell not rung */
+	spinlock_t xdp_lock;	/* xdp txq, posters and the dbell sweep */
+#endif
+#ifdef IONIC_XSK
+	struct xsk_buff_pool *xsk_pool;
+	u32 xsk_tx_done;	/* completions not yet reported to the pool */
+#endif
+#ifdef IONIC_PAGE_POOL
+	struct page_pool *page_pool;
+#else
+	struct ionic_page_cache *page_cache;
+#endif
 	char name[IONIC_QUEUE_NAME_MAX_SZ];
 } ____cacheline_aligned_in_smp;
 
@@ -288,7 +419,9 @@ struct ionic_intr_info {
 	u64 rearm_count;
 	unsigned int cpu;
 	cpumask_t affinity_mask;
+	struct irq_affinity_notify affinity_notify;
 	u32 dim_coal_hw;
+	u64 dim_transitions;
 };
 
 struct ionic_cq {
@@ -334,6 +467,15 @@ static inline bool ionic_q_has_space(struct ionic_queue *q, unsigned int want)
 	return ionic_q_space_avail(q) >= want;
 }
 
+static inline struct xsk_buff_pool *ionic_q_xsk_pool(struct ionic_queue *q)
+{
+#ifdef IONIC_XSK
+	return q->xsk_pool;
+#else
+	return NULL;
+#endif
+}
+
 void ionic_init_devinfo(struct ionic *ionic);
 int ionic_dev_setup(struct ionic *ionic);
 void ionic_dev_teardown(struct ionic *ionic);
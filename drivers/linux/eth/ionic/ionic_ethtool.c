@@ -31,8 +31,14 @@ static const char ionic_priv_flags_strings[][ETH_GSTRING_LEN] = {
 	"device-reset",
 #define IONIC_PRIV_F_CMB_RINGS		BIT(2)
 	"cmb-rings",
-
-#define IONIC_PRIV_F_SW_DBG_STATS	BIT(3)
+#define IONIC_PRIV_F_TX_BOUNCE		BIT(3)
+	"tx-bounce",
+#define IONIC_PRIV_F_THREADED_NAPI	BIT(4)
+	"threaded-napi",
+#define IONIC_PRIV_F_AUTO_SPLIT_INTR	BIT(5)
+	"auto-split-intr",
+
+#define IONIC_PRIV_F_SW_DBG_STATS	BIT(6)
 #ifdef IONIC_DEBUG_STATS
 	"sw-dbg-stats",
 #endif
@@ -542,8 +548,7 @@ static int ionic_set_coalesce(struct net_device *netdev,
 {
 	struct ionic_lif *lif = netdev_priv(netdev);
 	struct ionic_identity *ident;
-	u32 rx_coal, rx_dim;
-	u32 tx_coal, tx_dim;
+	u32 rx_coal, tx_coal;
 	unsigned int i;
 
 	if (coalesce->rx_max_coalesced_frames ||
@@ -605,43 +610,146 @@ static int ionic_set_coalesce(struct net_device *netdev,
 		lif->tx_coalesce_usecs = coalesce->rx_coalesce_usecs;
 	lif->tx_coalesce_hw = tx_coal;
 
-	if (coalesce->use_adaptive_rx_coalesce) {
+	if (coalesce->use_adaptive_rx_coalesce)
 		set_bit(IONIC_LIF_F_RX_DIM_INTR, lif->state);
-		rx_dim = rx_coal;
-	} else {
+	else
 		clear_bit(IONIC_LIF_F_RX_DIM_INTR, lif->state);
-		rx_dim = 0;
-	}
 
-	if (coalesce->use_adaptive_tx_coalesce) {
+	if (coalesce->use_adaptive_tx_coalesce)
 		set_bit(IONIC_LIF_F_TX_DIM_INTR, lif->state);
-		tx_dim = tx_coal;
-	} else {
+	else
 		clear_bit(IONIC_LIF_F_TX_DIM_INTR, lif->state);
-		tx_dim = 0;
-	}
+
+	/* The lif-wide setting replaces any per-queue overrides */
+	memset(lif->txq_coal, 0,
+	       lif->ionic->ntxqs_per_lif * sizeof(*lif->txq_coal));
+	memset(lif->rxq_coal, 0,
+	       lif->ionic->nrxqs_per_lif * sizeof(*lif->rxq_coal));
 
 	if (test_bit(IONIC_LIF_F_UP, lif->state)) {
 		for (i = 0; i < lif->nxqs; i++) {
-			if (lif->rxqcqs[i]->flags & IONIC_QCQ_F_INTR) {
-				ionic_intr_coal_init(lif->ionic->idev.intr_ctrl,
-						     lif->rxqcqs[i]->intr.index,
-						     lif->rx_coalesce_hw);
-				lif->rxqcqs[i]->intr.dim_coal_hw = rx_dim;
-			}
-
-			if (lif->txqcqs[i]->flags & IONIC_QCQ_F_INTR) {
-				ionic_intr_coal_init(lif->ionic->idev.intr_ctrl,
-						     lif->txqcqs[i]->intr.index,
-						     lif->tx_coalesce_hw);
-				lif->txqcqs[i]->intr.dim_coal_hw = tx_dim;
-			}
+			ionic_lif_qcq_coal_init(lif, lif->rxqcqs[i]);
+			ionic_lif_qcq_coal_init(lif, lif->txqcqs[i]);
 		}
 	}
 
 	return 0;
 }
 
+#ifdef ETHTOOL_PERQUEUE
+static int ionic_get_per_queue_coalesce(struct net_device *netdev, u32 queue,
+					struct ethtool_coalesce *coalesce)
+{
+	struct ionic_lif *lif = netdev_priv(netdev);
+	struct ionic_queue_coal *qc;
+
+	if (queue >= lif->nxqs)
+		return -EINVAL;
+
+	qc = &lif->rxq_coal[queue];
+	if (qc->override) {
+		coalesce->rx_coalesce_usecs = qc->usecs;
+		coalesce->use_adaptive_rx_coalesce = qc->adaptive;
+	} else {
+		coalesce->rx_coalesce_usecs = lif->rx_coalesce_usecs;
+		coalesce->use_adaptive_rx_coalesce =
+			test_bit(IONIC_LIF_F_RX_DIM_INTR, lif->state);
+	}
+
+	qc = &lif->txq_coal[queue];
+	if (!test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state)) {
+		coalesce->tx_coalesce_usecs = coalesce->rx_coalesce_usecs;
+		coalesce->use_adaptive_tx_coalesce = 0;
+	} else if (qc->override) {
+		coalesce->tx_coalesce_usecs = qc->usecs;
+		coalesce->use_adaptive_tx_coalesce = qc->adaptive;
+	} else {
+		coalesce->tx_coalesce_usecs = lif->tx_coalesce_usecs;
+		coalesce->use_adaptive_tx_coalesce =
+			test_bit(IONIC_LIF_F_TX_DIM_INTR, lif->state);
+	}
+
+	return 0;
+}
+
+static int ionic_set_per_queue_coalesce(struct net_device *netdev, u32 queue,
+					struct ethtool_coalesce *coalesce)
+{
+	struct ionic_lif *lif = netdev_priv(netdev);
+	struct ionic_queue_coal *txqc, *rxqc;
+	bool split;
+	u32 rx_coal;
+	u32 tx_coal;
+
+	if (queue >= lif->nxqs)
+		return -EINVAL;
+
+	/* Only the interrupt timers are per-queue */
+	if (coalesce->rx_max_coalesced_frames ||
+	    coalesce->rx_coalesce_usecs_irq ||
+	    coalesce->rx_max_coalesced_frames_irq ||
+	    coalesce->tx_max_coalesced_frames ||
+	    coalesce->tx_coalesce_usecs_irq ||
+	    coalesce->tx_max_coalesced_frames_irq ||
+	    coalesce->stats_block_coalesce_usecs ||
+	    coalesce->pkt_rate_low ||
+	    coalesce->rx_coalesce_usecs_low ||
+	    coalesce->rx_max_coalesced_frames_low ||
+	    coalesce->tx_coalesce_usecs_low ||
+	    coalesce->tx_max_coalesced_frames_low ||
+	    coalesce->pkt_rate_high ||
+	    coalesce->rx_coalesce_usecs_high ||
+	    coalesce->rx_max_coalesced_frames_high ||
+	    coalesce->tx_coalesce_usecs_high ||
+	    coalesce->tx_max_coalesced_frames_high ||
+	    coalesce->rate_sample_interval)
+		return -EINVAL;
+
+	if (lif->ionic->ident.dev.intr_coal_div == 0)
+		return -EIO;
+
+	split = test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state);
+	if (!split &&
+	    (coalesce->tx_coalesce_usecs != coalesce->rx_coalesce_usecs ||
+	     coalesce->use_adaptive_tx_coalesce)) {
+		netdev_warn(netdev, "only rx parameters can be changed\n");
+		return -EINVAL;
+	}
+
+	rx_coal = ionic_coal_usec_to_hw(lif->ionic, coalesce->rx_coalesce_usecs);
+	if (!rx_coal && coalesce->rx_coalesce_usecs)
+		rx_coal = 1;
+	tx_coal = ionic_coal_usec_to_hw(lif->ionic, coalesce->tx_coalesce_usecs);
+	if (!tx_coal && coalesce->tx_coalesce_usecs)
+		tx_coal = 1;
+
+	if (rx_coal > IONIC_INTR_CTRL_COAL_MAX ||
+	    tx_coal > IONIC_INTR_CTRL_COAL_MAX)
+		return -ERANGE;
+
+	rxqc = &lif->rxq_coal[queue];
+	rxqc->usecs = coalesce->rx_coalesce_usecs;
+	rxqc->hw = rx_coal;
+	rxqc->adaptive = !!coalesce->use_adaptive_rx_coalesce;
+	rxqc->override = true;
+
+	if (split) {
+		txqc = &lif->txq_coal[queue];
+		txqc->usecs = coalesce->tx_coalesce_usecs;
+		txqc->hw = tx_coal;
+		txqc->adaptive = !!coalesce->use_adaptive_tx_coalesce;
+		txqc->override = true;
+	}
+
+	if (test_bit(IONIC_LIF_F_UP, lif->state)) {
+		ionic_lif_qcq_coal_init(lif, lif->rxqcqs[queue]);
+		ionic_lif_qcq_coal_init(lif, lif->txqcqs[queue]);
+	}
+
+	return 0;
+}
+#endif /* ETHTOOL_PERQUEUE */
+
 static int ionic_validate_cmb_config(struct ionic_lif *lif,
 				     struct ionic_queue_params *qparam)
 {
@@ -750,6 +858,12 @@ static void ionic_get_ringparam(struct net_device *netdev,
 	kernel_ring->tx_push = test_bit(IONIC_LIF_F_CMB_TX_RINGS, lif->state);
 	kernel_ring->rx_push = test_bit(IONIC_LIF_F_CMB_RX_RINGS, lif->state);
 #endif
+#ifdef HAVE_TCP_DATA_SPLIT_SET
+	if (test_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state))
+		kernel_ring->tcp_data_split = ETHTOOL_TCP_DATA_SPLIT_ENABLED;
+	else
+		kernel_ring->tcp_data_split = ETHTOOL_TCP_DATA_SPLIT_DISABLED;
+#endif
 }
 
 #ifdef HAVE_RINGPARAM_EXTACK
@@ -796,9 +910,23 @@ static int ionic_set_ringparam(struct net_device *netdev,
 		return -EINVAL;
 	}
 
+#ifdef HAVE_TCP_DATA_SPLIT_SET
+	if (kernel_ring->tcp_data_split != ETHTOOL_TCP_DATA_SPLIT_UNKNOWN)
+		qparam.hdr_split = kernel_ring->tcp_data_split ==
+				   ETHTOOL_TCP_DATA_SPLIT_ENABLED;
+#endif
+
+#ifdef IONIC_XDP
+	if (qparam.hdr_split && lif->xdp_prog) {
+		netdev_info(netdev, "Header split not supported with XDP\n");
+		return -EINVAL;
+	}
+#endif
+
 	/* if nothing to do return success */
 	if (ring->tx_pending == lif->ntxq_descs &&
-	    ring->rx_pending == lif->nrxq_descs
+	    ring->rx_pending == lif->nrxq_descs &&
+	    qparam.hdr_split == test_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state)
 #ifdef HAVE_RX_PUSH
 	    &&
 	    kernel_ring->tx_push == test_bit(IONIC_LIF_F_CMB_TX_RINGS, lif->state) &&
@@ -836,10 +964,18 @@ static int ionic_set_ringparam(struct net_device *netdev,
 		netdev_info(netdev, "Changing Rx ring size from %d to %d\n",
 			    lif->nrxq_descs, ring->rx_pending);
 
+	if (qparam.hdr_split != test_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state))
+		netdev_info(netdev, "%s Rx header split\n",
+			    qparam.hdr_split ? "Enabling" : "Disabling");
+
 	/* if we're not running, just set the values and return */
 	if (!netif_running(lif->netdev)) {
 		lif->ntxq_descs = ring->tx_pending;
 		lif->nrxq_descs = ring->rx_pending;
+		if (qparam.hdr_split)
+			set_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state);
+		else
+			clear_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state);
 		return 0;
 	}
 
@@ -957,6 +1093,8 @@ static int ionic_set_channels(struct net_device *netdev,
 			clear_bit(IONIC_LIF_F_SPLIT_INTR, lif->state);
 			lif->tx_coalesce_usecs = lif->rx_coalesce_usecs;
 			lif->tx_coalesce_hw = lif->rx_coalesce_hw;
+			memset(lif->txq_coal, 0, lif->ionic->ntxqs_per_lif *
+						 sizeof(*lif->txq_coal));
 		}
 		return 0;
 	}
@@ -1004,6 +1142,17 @@ static u32 ionic_get_priv_flags(struct net_device *netdev)
 	    test_bit(IONIC_LIF_F_CMB_RX_RINGS, lif->state))
 		priv_flags |= IONIC_PRIV_F_CMB_RINGS;
 
+	if (test_bit(IONIC_LIF_F_TX_BOUNCE, lif->state))
+		priv_flags |= IONIC_PRIV_F_TX_BOUNCE;
+
+#ifdef HAVE_DEV_SET_THREADED
+	if (netdev->threaded)
+		priv_flags |= IONIC_PRIV_F_THREADED_NAPI;
+#endif
+
+	if (test_bit(IONIC_LIF_F_AUTO_SPLIT_INTR, lif->state))
+		priv_flags |= IONIC_PRIV_F_AUTO_SPLIT_INTR;
+
 	return priv_flags;
 }
 
@@ -1039,6 +1188,35 @@ static int ionic_set_priv_flags(struct net_device *netdev, u32 priv_flags)
 			return ret;
 	}
 
+	if (!!(priv_flags & IONIC_PRIV_F_TX_BOUNCE) !=
+	    test_bit(IONIC_LIF_F_TX_BOUNCE, lif->state)) {
+		if (netif_running(netdev)) {
+			netdev_info(netdev, "Please stop device to toggle tx-bounce\n");
+			return -EBUSY;
+		}
+		change_bit(IONIC_LIF_F_TX_BOUNCE, lif->state);
+	}
+
+	if (!!(priv_flags & IONIC_PRIV_F_THREADED_NAPI) !=
+	    !!(ionic_get_priv_flags(netdev) & IONIC_PRIV_F_THREADED_NAPI)) {
+		ret = ionic_lif_set_threaded(lif,
+					     priv_flags & IONIC_PRIV_F_THREADED_NAPI);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (priv_flags & IONIC_PRIV_F_AUTO_SPLIT_INTR) {
+		if (!test_and_set_bit(IONIC_LIF_F_AUTO_SPLIT_INTR, lif->state)) {
+			mutex_lock(&lif->queue_lock);
+			lif->intr_auto_split =
+				test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state);
+			lif->intr_auto_jiffies = 0;
+			mutex_unlock(&lif->queue_lock);
+		}
+	} else {
+		clear_bit(IONIC_LIF_F_AUTO_SPLIT_INTR, lif->state);
+	}
+
 	return 0;
 }
 
@@ -1099,6 +1277,31 @@ static int ionic_set_rxfh(struct net_device *netdev, const u32 *indir,
 	return ionic_lif_rss_config(lif, lif->rss_types, key, indir);
 }
 
+/* There is no per-queue tunable, so this sets the ceiling for every
+ * Rx queue; each queue's adaptive copybreak then settles under it.
+ */
+static void ionic_set_rx_copybreak(struct ionic_lif *lif, u32 copybreak)
+{
+	struct ionic_rx_copybreak *cb;
+	unsigned int i;
+
+	mutex_lock(&lif->queue_lock);
+	lif->rx_copybreak = copybreak;
+	for (i = 0; lif->rxqcqs && i < lif->ionic->nrxqs_per_lif; i++) {
+		if (!lif->rxqcqs[i])
+			continue;
+		cb = &lif->rxqcqs[i]->q.copybreak;
+		WRITE_ONCE(cb->ceiling, copybreak);
+		WRITE_ONCE(cb->value, copybreak);
+	}
+	if (lif->hwstamp_rxq) {
+		cb = &lif->hwstamp_rxq->q.copybreak;
+		WRITE_ONCE(cb->ceiling, copybreak);
+		WRITE_ONCE(cb->value, copybreak);
+	}
+	mutex_unlock(&lif->queue_lock);
+}
+
 static int ionic_set_tunable(struct net_device *dev,
 			     const struct ethtool_tunable *tuna,
 			     const void *data)
@@ -1107,7 +1310,7 @@ static int ionic_set_tunable(struct net_device *dev,
 
 	switch (tuna->id) {
 	case ETHTOOL_RX_COPYBREAK:
-		lif->rx_copybreak = *(u32 *)data;
+		ionic_set_rx_copybreak(lif, *(u32 *)data);
 		break;
 	default:
 		return -EOPNOTSUPP;
@@ -1345,7 +1548,11 @@ static const struct ethtool_ops ionic_ethtool_ops = {
 				     ETHTOOL_COALESCE_USE_ADAPTIVE_RX |
 				     ETHTOOL_COALESCE_USE_ADAPTIVE_TX,
 #endif
-#ifdef HAVE_RX_PUSH
+#if defined(HAVE_TCP_DATA_SPLIT_SET)
+	.supported_ring_params = ETHTOOL_RING_USE_TX_PUSH |
+				 ETHTOOL_RING_USE_RX_PUSH |
+				 ETHTOOL_RING_USE_TCP_DATA_SPLIT,
+#elif defined(HAVE_RX_PUSH)
 	.supported_ring_params = ETHTOOL_RING_USE_TX_PUSH |
 				 ETHTOOL_RING_USE_RX_PUSH,
 #endif
@@ -1357,6 +1564,10 @@ static const struct ethtool_ops ionic_ethtool_ops = {
 	.set_link_ksettings	= ionic_set_link_ksettings,
 	.get_coalesce		= ionic_get_coalesce,
 	.set_coalesce		= ionic_set_coalesce,
+#ifdef ETHTOOL_PERQUEUE
+	.get_per_queue_coalesce	= ionic_get_per_queue_coalesce,
+	.set_per_queue_coalesce	= ionic_set_per_queue_coalesce,
+#endif
 	.get_ringparam		= ionic_get_ringparam,
 	.set_ringparam		= ionic_set_ringparam,
 	.get_channels		= ionic_get_channels,
@@ -45,33 +45,104 @@ static int ionic_open(struct net_device *netdev);
 static void ionic_stop_queues(struct ionic_lif *lif);
 static int ionic_stop(struct net_device *netdev);
 static void ionic_lif_queue_identify(struct ionic_lif *lif);
+static void ionic_qcq_tx_bounce_free(struct ionic_lif *lif,
+				     struct ionic_qcq *qcq);
+static void ionic_napi_thread_pin(struct ionic_qcq *qcq);
+#ifdef IONIC_XDP
+static void ionic_xdp_txqs_alloc(struct ionic_lif *lif);
+static void ionic_xdp_txqs_free(struct ionic_lif *lif);
+#endif
+
+/* DIM moderation profiles, least to most coalescing.  The generic
+ * net_dim tables top out at 256us and several neighbouring entries
+ * collapse to the same value at the device's coalescing resolution,
+ * so use our own, with Tx kept a little lazier than Rx since Tx
+ * completions only free buffers.
+ */
+static const u32 ionic_dim_rx_usecs[IONIC_DIM_NUM_PROFILES] = {
+	2, 8, 24, 64, 128
+};
+
+static const u32 ionic_dim_tx_usecs[IONIC_DIM_NUM_PROFILES] = {
+	4, 16, 32, 64, 96
+};
+
+static void ionic_dim_profile_to_hw(struct ionic_lif *lif, const u32 *usecs,
+				    u32 *hw)
+{
+	u32 prev = 0;
+	int i;
+
+	/* Keep each step at least one hw unit above the last so that
+	 * every profile change DIM makes is one the device can see.
+	 */
+	for (i = 0; i < IONIC_DIM_NUM_PROFILES; i++) {
+		hw[i] = ionic_coal_usec_to_hw(lif->ionic, usecs[i]);
+		hw[i] = max(hw[i], prev + 1);
+		hw[i] = min_t(u32, hw[i], IONIC_INTR_CTRL_COAL_MAX);
+		prev = hw[i];
+	}
+}
 
 static void ionic_dim_work(struct work_struct *work)
 {
 	struct dim *dim = container_of(work, struct dim, work);
-	struct dim_cq_moder cur_moder;
 	struct ionic_qcq *qcq;
+	struct ionic_lif *lif;
 	u32 new_coal;
 
-	cur_moder = net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
 	qcq = container_of(dim, struct ionic_qcq, dim);
-	new_coal = ionic_coal_usec_to_hw(qcq->q.lif->ionic, cur_moder.usec);
-	new_coal = new_coal ? new_coal : 1;
+	lif = qcq->q.lif;
 
-	if (qcq->intr.dim_coal_hw != new_coal) {
-		unsigned int qi = qcq->cq.bound_q->index;
-		struct ionic_lif *lif = qcq->q.lif;
+	if (qcq->q.type == IONIC_QTYPE_TXQ)
+		new_coal = lif->dim_tx_hw[dim->profile_ix];
+	else
+		new_coal = lif->dim_rx_hw[dim->profile_ix];
 
+	if (qcq->intr.dim_coal_hw != new_coal) {
 		qcq->intr.dim_coal_hw = new_coal;
+		qcq->intr.dim_transitions++;
 
 		ionic_intr_coal_init(lif->ionic->idev.intr_ctrl,
-				     lif->rxqcqs[qi]->intr.index,
+				     qcq->intr.index,
 				     qcq->intr.dim_coal_hw);
 	}
 
 	dim->state = DIM_START_MEASURE;
 }
 
+/* Program a TxRx qcq's interrupt coalescing from its per-queue override,
+ * if it has one, else from the lif-wide ethtool values
+ */
+void ionic_lif_qcq_coal_init(struct ionic_lif *lif, struct ionic_qcq *qcq)
+{
+	struct ionic_queue_coal *qc;
+	u32 coal_hw;
+	bool dim;
+
+	if (!(qcq->flags & IONIC_QCQ_F_INTR))
+		return;
+
+	if (qcq->q.type == IONIC_QTYPE_TXQ) {
+		qc = &lif->txq_coal[qcq->q.index];
+		coal_hw = lif->tx_coalesce_hw;
+		dim = test_bit(IONIC_LIF_F_TX_DIM_INTR, lif->state);
+	} else {
+		qc = &lif->rxq_coal[qcq->q.index];
+		coal_hw = lif->rx_coalesce_hw;
+		dim = test_bit(IONIC_LIF_F_RX_DIM_INTR, lif->state);
+	}
+
+	if (qc->override) {
+		coal_hw = qc->hw;
+		dim = qc->adaptive;
+	}
+
+	ionic_intr_coal_init(lif->ionic->idev.intr_ctrl, qcq->intr.index,
+			     coal_hw);
+	qcq->intr.dim_coal_hw = dim ? coal_hw : 0;
+}
+
 static void ionic_lif_deferred_work(struct work_struct *work)
 {
 	struct ionic_lif *lif = container_of(work, struct ionic_lif, deferred.work);
@@ -97,6 +168,9 @@ static void ionic_lif_deferred_work(struct work_struct *work)
 		case IONIC_DW_TYPE_LINK_STATUS:
 			ionic_link_status_check(lif);
 			break;
+		case IONIC_DW_TYPE_INTR_MODE:
+			ionic_lif_intr_mode_check(lif);
+			break;
 		case IONIC_DW_TYPE_LIF_RESET:
 			if (w->fw_status) {
 				ionic_lif_handle_fw_up(lif);
@@ -206,11 +280,76 @@ void ionic_link_status_check_request(struct ionic_lif *lif, bool can_sleep)
 	}
 }
 
-static void ionic_napi_deadline(struct timer_list *timer)
+/* Missed-doorbell recovery.  Rather than push a timer out on every
+ * doorbell, sweep the lif's queues every IONIC_NAPI_DEADLINE and kick
+ * the napi of any queue that still has descriptors outstanding but
+ * hasn't rung its doorbell since.  If that poll finds no work it calls
+ * the poke_doorbell helpers, which re-ring once dbell_deadline is past.
+ * The sweep lives from adminq init to deinit, since adminq commands run
+ * while the lif is down too; the TxRx and XDP queues are only looked at
+ * while up.  It runs on the freezable wq so that it stays out of the way
+ * across suspend.
+ */
+static void ionic_dbell_sweep_q(struct ionic_lif *lif, struct ionic_queue *q,
+				struct ionic_qcq *napi_qcq, unsigned long now)
+{
+	if (!napi_qcq || READ_ONCE(q->head_idx) == READ_ONCE(q->tail_idx))
+		return;
+
+	if (!time_after(now, READ_ONCE(q->dbell_jiffies) + IONIC_NAPI_DEADLINE))
+		return;
+
+	local_bh_disable();
+	if (napi_schedule_prep(&napi_qcq->napi)) {
+		__napi_schedule(&napi_qcq->napi);
+		lif->dbell_sweep_kicks++;
+	}
+	local_bh_enable();
+}
+
+static void ionic_dbell_sweep(struct work_struct *work)
 {
-	struct ionic_qcq *qcq = container_of(timer, struct ionic_qcq, napi_deadline);
+	struct ionic_lif *lif = container_of(to_delayed_work(work),
+					     struct ionic_lif, dbell_sweep);
+	struct ionic_qcq *adminqcq = lif->adminqcq;
+	unsigned long now = jiffies;
+	struct ionic_qcq *qcq;
+	unsigned int i;
+
+	ionic_dbell_sweep_q(lif, &adminqcq->q, adminqcq, now);
+
+	/* the TxRx and hwstamp queues come and go under the queue_lock;
+	 * if someone is busy with them, catch them on the next sweep
+	 */
+	if (mutex_trylock(&lif->queue_lock)) {
+		/* the hwstamp queues are serviced by the adminq napi */
+		if (lif->hwstamp_rxq)
+			ionic_dbell_sweep_q(lif, &lif->hwstamp_rxq->q,
+					    adminqcq, now);
+		for (i = 0; i < lif->nhwstamp_txqs; i++)
+			ionic_dbell_sweep_q(lif, &lif->hwstamp_txqs[i]->q,
+					    adminqcq, now);
+
+		if (test_bit(IONIC_LIF_F_UP, lif->state)) {
+			for (i = 0; i < lif->nxqs; i++) {
+				qcq = lif->txqcqs[i];
+				ionic_dbell_sweep_q(lif, &qcq->q,
+						    qcq->napi_qcq, now);
+				qcq = lif->rxqcqs[i];
+				ionic_dbell_sweep_q(lif, &qcq->q,
+						    qcq->napi_qcq, now);
+			}
+#ifdef IONIC_XDP
+			/* no napi of their own, serviced right here */
+			for (i = 0; i < lif->nxdp_txqs; i++)
+				ionic_xdp_txq_service(&lif->xdp_txqcqs[i]->q);
+#endif
+		}
+		mutex_unlock(&lif->queue_lock);
+	}
 
-	napi_schedule(&qcq->napi);
+	queue_delayed_work(system_freezable_wq, &lif->dbell_sweep,
+			   IONIC_NAPI_DEADLINE);
 }
 
 static irqreturn_t ionic_isr(int irq, void *data)
@@ -296,8 +435,10 @@ static int ionic_qcq_enable(struct ionic_qcq *qcq)
 	if (ret)
 		return ret;
 
-	if (qcq->napi.poll)
+	if (qcq->napi.poll) {
 		napi_enable(&qcq->napi);
+		ionic_napi_thread_pin(qcq);
+	}
 
 	if (qcq->flags & IONIC_QCQ_F_INTR) {
 		irq_set_affinity_hint(qcq->intr.vector,
@@ -328,10 +469,8 @@ static int ionic_qcq_disable(struct ionic_lif *lif, struct ionic_qcq *qcq, int f
 
 	q = &qcq->q;
 
-	if (qcq->napi.poll) {
+	if (qcq->napi.poll)
 		napi_disable(&qcq->napi);
-		del_timer_sync(&qcq->napi_deadline);
-	}
 
 	if (qcq->flags & IONIC_QCQ_F_INTR) {
 		struct ionic_dev *idev = &lif->ionic->idev;
@@ -358,6 +497,83 @@ static int ionic_qcq_disable(struct ionic_lif *lif, struct ionic_qcq *qcq, int f
 	return ionic_adminq_post_wait(lif, &ctx);
 }
 
+#ifdef IONIC_XDP
+static int ionic_xdp_register_rxq_info(struct ionic_queue *q,
+				       unsigned int napi_id)
+{
+	enum xdp_mem_type mem_type = MEM_TYPE_PAGE_ORDER0;
+	struct xdp_rxq_info *rxq_info;
+	void *allocator = NULL;
+	int err;
+
+#ifdef IONIC_PAGE_POOL
+	mem_type = MEM_TYPE_PAGE_POOL;
+	allocator = q->page_pool;
+#endif
+#ifdef IONIC_XSK
+	if (q->xsk_pool) {
+		mem_type = MEM_TYPE_XSK_BUFF_POOL;
+		allocator = NULL;
+	}
+#endif
+
+	rxq_info = kzalloc(sizeof(*rxq_info), GFP_KERNEL);
+	if (!rxq_info)
+		return -ENOMEM;
+
+	err = xdp_rxq_info_reg(rxq_info, q->lif->netdev, q->index, napi_id);
+	if (err) {
+		dev_err(q->dev, "Queue %d xdp_rxq_info_reg failed, err %d\n",
+			q->index, err);
+		goto err_out;
+	}
+
+	err = xdp_rxq_info_reg_mem_model(rxq_info, mem_type, allocator);
+	if (err) {
+		dev_err(q->dev, "Queue %d xdp_rxq_info_reg_mem_model failed, err %d\n",
+			q->index, err);
+		xdp_rxq_info_unreg(rxq_info);
+		goto err_out;
+	}
+
+#ifdef IONIC_XSK
+	if (q->xsk_pool)
+		xsk_pool_set_rxq_info(q->xsk_pool, rxq_info);
+#endif
+
+	q->xdp_rxq_info = rxq_info;
+
+	return 0;
+
+err_out:
+	kfree(rxq_info);
+	return err;
+}
+
+static void ionic_xdp_unregister_rxq_info(struct ionic_queue *q)
+{
+	if (!q->xdp_rxq_info)
+		return;
+
+	xdp_rxq_info_unreg(q->xdp_rxq_info);
+	kfree(q->xdp_rxq_info);
+	q->xdp_rxq_info = NULL;
+	q->xdp_prog = NULL;
+}
+#endif /* IONIC_XDP */
+
+#ifdef IONIC_XSK
+static struct xsk_buff_pool *ionic_lif_xsk_pool(struct ionic_lif *lif,
+						struct ionic_qcq *qcq)
+{
+	if (!lif->xsk_pools || qcq->flags & IONIC_QCQ_F_XDP ||
+	    qcq->q.features & IONIC_TXQ_F_HWSTAMP || qcq == lif->hwstamp_rxq)
+		return NULL;
+
+	return lif->xsk_pools[qcq->q.index];
+}
+#endif
+
 static void ionic_lif_qcq_deinit(struct ionic_lif *lif, struct ionic_qcq *qcq)
 {
 	struct ionic_dev *idev = &lif->ionic->idev;
@@ -374,6 +590,10 @@ static void ionic_lif_qcq_deinit(struct ionic_lif *lif, struct ionic_qcq *qcq)
 		netif_napi_del(&qcq->napi);
 	}
 
+#ifdef IONIC_XDP
+	ionic_xdp_unregister_rxq_info(&qcq->q);
+#endif
+
 	qcq->flags &= ~IONIC_QCQ_F_INITED;
 }
 
@@ -382,6 +602,7 @@ static void ionic_qcq_intr_free(struct ionic_lif *lif, struct ionic_qcq *qcq)
 	if (!(qcq->flags & IONIC_QCQ_F_INTR) || qcq->intr.vector == 0)
 		return;
 
+	irq_set_affinity_notifier(qcq->intr.vector, NULL);
 	irq_set_affinity_hint(qcq->intr.vector, NULL);
 	devm_free_irq(lif->ionic->dev, qcq->intr.vector, &qcq->napi);
 	qcq->intr.vector = 0;
@@ -425,6 +646,8 @@ static void ionic_qcq_free(struct ionic_lif *lif, struct ionic_qcq *qcq)
 		qcq->sg_base_pa = 0;
 	}
 
+	ionic_qcq_tx_bounce_free(lif, qcq);
+
 	ionic_qcq_intr_free(lif, qcq);
 
 	if (qcq->cq.info) {
@@ -435,6 +658,16 @@ static void ionic_qcq_free(struct ionic_lif *lif, struct ionic_qcq *qcq)
 		vfree(qcq->q.info);
 		qcq->q.info = NULL;
 	}
+
+#ifdef IONIC_PAGE_POOL
+	if (qcq->q.page_pool) {
+		page_pool_destroy(qcq->q.page_pool);
+		qcq->q.page_pool = NULL;
+	}
+#else
+	kvfree(qcq->q.page_cache);
+	qcq->q.page_cache = NULL;
+#endif
 }
 
 static void ionic_qcqs_free(struct ionic_lif *lif)
@@ -460,6 +693,21 @@ static void ionic_qcqs_free(struct ionic_lif *lif)
 		}
 	}
 
+	if (lif->qpair_rates) {
+		devm_kfree(dev, lif->qpair_rates);
+		lif->qpair_rates = NULL;
+	}
+
+	if (lif->rxq_coal) {
+		devm_kfree(dev, lif->rxq_coal);
+		lif->rxq_coal = NULL;
+	}
+
+	if (lif->txq_coal) {
+		devm_kfree(dev, lif->txq_coal);
+		lif->txq_coal = NULL;
+	}
+
 	if (lif->rxqcqs) {
 		devm_kfree(dev, lif->rxqstats);
 		lif->rxqstats = NULL;
@@ -473,6 +721,13 @@ static void ionic_qcqs_free(struct ionic_lif *lif)
 		devm_kfree(dev, lif->txqcqs);
 		lif->txqcqs = NULL;
 	}
+
+#ifdef IONIC_XDP
+	if (lif->xdp_txqcqs) {
+		devm_kfree(dev, lif->xdp_txqcqs);
+		lif->xdp_txqcqs = NULL;
+	}
+#endif
 }
 
 static void ionic_link_qcq_interrupts(struct ionic_qcq *src_qcq,
@@ -488,6 +743,184 @@ static void ionic_link_qcq_interrupts(struct ionic_qcq *src_qcq,
 	n_qcq->napi_qcq = src_qcq->napi_qcq;
 }
 
+#ifdef CONFIG_XPS
+/* Read back the CPUs the stack currently steers txq qi from, the way
+ * xps_cpus_show() does.  Returns false where the maps can't be walked.
+ */
+static bool ionic_xps_map_get(struct net_device *netdev, unsigned int qi,
+			      cpumask_t *mask)
+{
+#if defined(HAVE_NETDEV_XPS_MAPS) || defined(HAVE_NETDEV_XPS_CPUS_MAP)
+	struct xps_dev_maps *dev_maps;
+	unsigned int cpu, nr_ids;
+	struct xps_map *map;
+	int num_tc, tc, i;
+
+	cpumask_clear(mask);
+
+	tc = netdev_txq_to_tc(netdev, qi);
+	if (tc < 0)
+		return false;
+
+	rcu_read_lock();
+#ifdef HAVE_NETDEV_XPS_MAPS
+	dev_maps = rcu_dereference(netdev->xps_maps[XPS_CPUS]);
+	num_tc = dev_maps ? dev_maps->num_tc : 0;
+	nr_ids = dev_maps ? dev_maps->nr_ids : 0;
+#else
+	dev_maps = rcu_dereference(netdev->xps_cpus_map);
+	num_tc = netdev_get_num_tc(netdev) ? : 1;
+	nr_ids = nr_cpu_ids;
+#endif
+	for (cpu = 0; dev_maps && tc < num_tc && cpu < nr_ids; cpu++) {
+		map = rcu_dereference(dev_maps->attr_map[cpu * num_tc + tc]);
+		for (i = 0; map && i < map->len; i++) {
+			if (map->queues[i] == qi) {
+				cpumask_set_cpu(cpu, mask);
+				break;
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	return true;
+#else
+	return false;
+#endif
+}
+#endif
+
+/* Steer the senders on a txq to the CPUs its completions are handled on,
+ * so head_idx and tail_idx don't bounce between caches.  The map follows
+ * the irq and the interrupt layout for as long as it is still the one
+ * the driver last set; once the admin writes their own, it is left alone.
+ */
+static void ionic_lif_set_xps(struct ionic_lif *lif, unsigned int qi)
+{
+#ifdef CONFIG_XPS
+	cpumask_t *last = &lif->xps_masks[qi];
+	cpumask_var_t cur;
+	struct ionic_qcq *qcq;
+	int err;
+
+	if (test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state))
+		qcq = lif->txqcqs[qi];
+	else
+		qcq = lif->rxqcqs[qi];
+
+	/* nothing is recorded, so this is tried again next time */
+	if (!qcq || cpumask_empty(&qcq->intr.affinity_mask))
+		return;
+
+	if (!zalloc_cpumask_var(&cur, GFP_KERNEL))
+		return;
+
+	if (ionic_xps_map_get(lif->netdev, qi, cur)) {
+		/* the stack drops CPUs from the map as they go offline */
+		cpumask_and(last, last, cpu_online_mask);
+		if (!cpumask_equal(cur, last))
+			goto out;
+	} else if (!cpumask_empty(last)) {
+		/* can't tell whose map it is, so only set it the once */
+		goto out;
+	}
+
+	err = netif_set_xps_queue(lif->netdev, &qcq->intr.affinity_mask, qi);
+	if (err) {
+		netdev_dbg(lif->netdev, "txq %u xps setup failed: %d\n",
+			   qi, err);
+		goto out;
+	}
+	cpumask_and(last, &qcq->intr.affinity_mask, cpu_online_mask);
+out:
+	free_cpumask_var(cur);
+#endif
+}
+
+#ifdef HAVE_DEV_SET_THREADED
+/* A threaded NAPI's kthread runs where its interrupt is steered, so the
+ * polling stays next to the queue just as it would in softirq.
+ */
+static void ionic_napi_thread_pin(struct ionic_qcq *qcq)
+{
+	struct task_struct *thread = READ_ONCE(qcq->napi.thread);
+
+	if (thread && qcq->flags & IONIC_QCQ_F_INTR &&
+	    !cpumask_empty(&qcq->intr.affinity_mask))
+		set_cpus_allowed_ptr(thread, &qcq->intr.affinity_mask);
+}
+
+/* Every NAPI on the netdev goes threaded together, the adminq/notifyq
+ * one included; its kthread is kept on the adminq interrupt's CPUs, away
+ * from the TxRx ones, so admin work doesn't delay data path polling.
+ */
+int ionic_lif_set_threaded(struct ionic_lif *lif, bool threaded)
+{
+	unsigned int i;
+	int err;
+
+	ASSERT_RTNL();
+
+	err = dev_set_threaded(lif->netdev, threaded);
+	if (err || !threaded)
+		return err;
+
+	mutex_lock(&lif->queue_lock);
+	if (lif->adminqcq)
+		ionic_napi_thread_pin(lif->adminqcq);
+	for (i = 0; lif->txqcqs && lif->rxqcqs && i < lif->nxqs; i++) {
+		if (lif->txqcqs[i])
+			ionic_napi_thread_pin(lif->txqcqs[i]);
+		if (lif->rxqcqs[i])
+			ionic_napi_thread_pin(lif->rxqcqs[i]);
+	}
+	mutex_unlock(&lif->queue_lock);
+
+	return 0;
+}
+#else
+static void ionic_napi_thread_pin(struct ionic_qcq *qcq)
+{
+}
+
+int ionic_lif_set_threaded(struct ionic_lif *lif, bool threaded)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+static void ionic_affinity_notify(struct irq_affinity_notify *notify,
+				  const cpumask_t *mask)
+{
+	struct ionic_intr_info *intr;
+	struct ionic_qcq *qcq;
+	struct ionic_lif *lif;
+
+	intr = container_of(notify, struct ionic_intr_info, affinity_notify);
+	qcq = container_of(intr, struct ionic_qcq, intr);
+	lif = qcq->q.lif;
+
+	cpumask_copy(&intr->affinity_mask, mask);
+
+	/* the kthread goes away with the queue; if the queues are being
+	 * reconfigured, they are pinned again when re-enabled
+	 */
+	if (!mutex_trylock(&lif->queue_lock))
+		return;
+	if (qcq->flags & IONIC_QCQ_F_INITED) {
+		ionic_napi_thread_pin(qcq);
+		if (qcq->q.index < lif->nxqs &&
+		    (qcq == lif->txqcqs[qcq->q.index] ||
+		     qcq == lif->rxqcqs[qcq->q.index]))
+			ionic_lif_set_xps(lif, qcq->q.index);
+	}
+	mutex_unlock(&lif->queue_lock);
+}
+
+static void ionic_affinity_release(struct kref *ref)
+{
+}
+
 static int ionic_alloc_qcq_interrupt(struct ionic_lif *lif, struct ionic_qcq *qcq)
 {
 	unsigned int cpu;
@@ -544,6 +977,14 @@ static int ionic_alloc_qcq_interrupt(struct ionic_lif *lif, struct ionic_qcq *qc
 					&qcq->intr.affinity_mask);
 	}
 
+	/* follow the irq if it is moved, and the txq's default XPS map */
+	if (qcq->q.type == IONIC_QTYPE_TXQ || qcq->q.type == IONIC_QTYPE_RXQ) {
+		qcq->intr.affinity_notify.notify = ionic_affinity_notify;
+		qcq->intr.affinity_notify.release = ionic_affinity_release;
+		irq_set_affinity_notifier(qcq->intr.vector,
+					  &qcq->intr.affinity_notify);
+	}
+
 	netdev_dbg(lif->netdev, "%s: Interrupt index %d\n", qcq->q.name, qcq->intr.index);
 	return 0;
 
@@ -553,6 +994,68 @@ err_out:
 	return err;
 }
 
+/* Best effort: a queue without a bounce area maps every head */
+static void ionic_qcq_tx_bounce_alloc(struct ionic_lif *lif,
+				      struct ionic_qcq *qcq)
+{
+	struct device *dev = lif->ionic->dev;
+	unsigned int slots;
+
+	slots = min_t(unsigned int, qcq->q.num_descs, IONIC_TX_BOUNCE_SLOTS);
+	qcq->tx_bounce_order =
+		get_order(slots * IONIC_TX_BOUNCE_SZ);
+	qcq->tx_bounce_size = PAGE_SIZE << qcq->tx_bounce_order;
+
+	qcq->tx_bounce_page = alloc_pages_node(qcq->q.node,
+					       GFP_KERNEL | __GFP_NOWARN,
+					       qcq->tx_bounce_order);
+	if (!qcq->tx_bounce_page) {
+		netdev_dbg(lif->netdev, "%s: no memory for tx bounce slots\n",
+			   qcq->q.name);
+		return;
+	}
+
+	/* mapped once here, only synced per packet */
+	qcq->tx_bounce_dma = dma_map_page(dev, qcq->tx_bounce_page, 0,
+					  qcq->tx_bounce_size, DMA_TO_DEVICE);
+	if (dma_mapping_error(dev, qcq->tx_bounce_dma)) {
+		netdev_dbg(lif->netdev, "%s: cannot map tx bounce slots\n",
+			   qcq->q.name);
+		__free_pages(qcq->tx_bounce_page, qcq->tx_bounce_order);
+		qcq->tx_bounce_page = NULL;
+		return;
+	}
+
+	qcq->tx_bounce_base = page_address(qcq->tx_bounce_page);
+	qcq->tx_bounce_slots = slots;
+}
+
+static void ionic_qcq_tx_bounce_free(struct ionic_lif *lif,
+				     struct ionic_qcq *qcq)
+{
+	if (!qcq->tx_bounce_page)
+		return;
+
+	dma_unmap_page(lif->ionic->dev, qcq->tx_bounce_dma,
+		       qcq->tx_bounce_size, DMA_TO_DEVICE);
+	__free_pages(qcq->tx_bounce_page, qcq->tx_bounce_order);
+	qcq->tx_bounce_page = NULL;
+	qcq->tx_bounce_base = NULL;
+	qcq->tx_bounce_slots = 0;
+}
+
+/* NUMA node of the CPU the queue's interrupt is aimed at, or of the
+ * device itself for queues without an interrupt of their own.
+ */
+static int ionic_qcq_node(struct ionic_lif *lif, struct ionic_qcq *qcq)
+{
+	if ((qcq->flags & IONIC_QCQ_F_INTR) &&
+	    !cpumask_empty(&qcq->intr.affinity_mask))
+		return cpu_to_node(cpumask_first(&qcq->intr.affinity_mask));
+
+	return dev_to_node(lif->ionic->dev);
+}
+
 static int ionic_qcq_alloc(struct ionic_lif *lif, unsigned int type,
 			   unsigned int index,
 			   const char *name, unsigned int flags,
@@ -582,17 +1085,6 @@ static int ionic_qcq_alloc(struct ionic_lif *lif, unsigned int type,
 	new->q.dev = dev;
 	new->flags = flags;
 
-	new->q.info = vzalloc_node(num_descs * sizeof(*new->q.info),
-				   dev_to_node(dev));
-	if (!new->q.info) {
-		new->q.info = vzalloc(num_descs * sizeof(*new->q.info));
-		if (!new->q.info) {
-			netdev_err(lif->netdev, "Cannot allocate queue info\n");
-			err = -ENOMEM;
-			goto err_out_free_qcq;
-		}
-	}
-
 	new->q.type = type;
 	new->q.max_sg_elems = lif->qtype_info[type].max_sg_elems;
 
@@ -600,22 +1092,36 @@ static int ionic_qcq_alloc(struct ionic_lif *lif, unsigned int type,
 			   desc_size, sg_desc_size, pid);
 	if (err) {
 		netdev_err(lif->netdev, "Cannot initialize queue\n");
-		goto err_out_free_q_info;
+		goto err_out_free_qcq;
 	}
 
 	err = ionic_alloc_qcq_interrupt(lif, new);
 	if (err)
-		goto err_out;
+		goto err_out_free_qcq;
+
+	/* the per-descriptor state and buffers live where the queue is serviced */
+	new->q.node = ionic_qcq_node(lif, new);
+
+	new->q.info = vzalloc_node(num_descs * sizeof(*new->q.info),
+				   new->q.node);
+	if (!new->q.info) {
+		new->q.info = vzalloc(num_descs * sizeof(*new->q.info));
+		if (!new->q.info) {
+			netdev_err(lif->netdev, "Cannot allocate queue info\n");
+			err = -ENOMEM;
+			goto err_out_free_irq;
+		}
+	}
 
 	new->cq.info = vzalloc_node(num_descs * sizeof(*new->cq.info),
-				    dev_to_node(dev));
+				    new->q.node);
 	if (!new->cq.info) {
 		new->cq.info = vzalloc(num_descs * sizeof(*new->cq.info));
 		if (!new->cq.info) {
 			netdev_err(lif->netdev,
 				   "Cannot allocate completion queue info\n");
 			err = -ENOMEM;
-			goto err_out_free_irq;
+			goto err_out_free_q_info;
 		}
 	}
 
@@ -719,6 +1225,57 @@ static int ionic_qcq_alloc(struct ionic_lif *lif, unsigned int type,
 		ionic_q_sg_map(&new->q, sg_base, sg_base_pa);
 	}
 
+	if (flags & IONIC_QCQ_F_TX_BOUNCE)
+		ionic_qcq_tx_bounce_alloc(lif, new);
+
+#ifdef IONIC_PAGE_POOL
+	if (type == IONIC_QTYPE_RXQ) {
+		struct page_pool_params pp_params = {
+			.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV,
+			.order = IONIC_PAGE_ORDER,
+			.pool_size = num_descs,
+			.nid = new->q.node,
+			.dev = dev,
+			.dma_dir = DMA_FROM_DEVICE,
+			.offset = 0,
+			.max_len = IONIC_PAGE_SIZE,
+		};
+
+#ifdef PP_FLAG_PAGE_FRAG
+		pp_params.flags |= PP_FLAG_PAGE_FRAG;
+#endif
+		new->q.page_pool = page_pool_create(&pp_params);
+		if (IS_ERR(new->q.page_pool)) {
+			netdev_err(lif->netdev, "Cannot create page_pool\n");
+			err = PTR_ERR(new->q.page_pool);
+			new->q.page_pool = NULL;
+			goto err_out_free_sg;
+		}
+	}
+#else
+	if (type == IONIC_QTYPE_RXQ) {
+		new->q.page_cache = kvzalloc_node(sizeof(*new->q.page_cache),
+						  GFP_KERNEL, new->q.node);
+		if (!new->q.page_cache) {
+			netdev_err(lif->netdev, "Cannot allocate page cache\n");
+			err = -ENOMEM;
+			goto err_out_free_sg;
+		}
+	}
+#endif
+
+	if (type == IONIC_QTYPE_RXQ) {
+		new->q.copybreak.ceiling = lif->rx_copybreak;
+		new->q.copybreak.value = lif->rx_copybreak;
+		new->q.copybreak.adaptive = rx_copybreak_adaptive;
+
+		/* the fresh queue's hist_base is zeroed, so start the
+		 * histogram it is read against over with it
+		 */
+		memset(q_to_rx_stats(&new->q)->size_hist, 0,
+		       sizeof(q_to_rx_stats(&new->q)->size_hist));
+	}
+
 	INIT_WORK(&new->dim.work, ionic_dim_work);
 	new->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
 
@@ -726,6 +1283,9 @@ static int ionic_qcq_alloc(struct ionic_lif *lif, unsigned int type,
 
 	return 0;
 
+err_out_free_sg:
+	if (new->sg_base)
+		dma_free_coherent(dev, new->sg_size, new->sg_base, new->sg_base_pa);
 err_out_free_cq:
 	dma_free_coherent(dev, new->cq_size, new->cq_base, new->cq_base_pa);
 err_out_free_q:
@@ -736,13 +1296,14 @@ err_out_free_q:
 	dma_free_coherent(dev, new->q_size, new->q_base, new->q_base_pa);
 err_out_free_cq_info:
 	vfree(new->cq.info);
+err_out_free_q_info:
+	vfree(new->q.info);
 err_out_free_irq:
 	if (flags & IONIC_QCQ_F_INTR) {
+		irq_set_affinity_notifier(new->intr.vector, NULL);
 		devm_free_irq(dev, new->intr.vector, &new->napi);
 		ionic_intr_free(lif->ionic, new->intr.index);
 	}
-err_out_free_q_info:
-	vfree(new->q.info);
 err_out_free_qcq:
 	devm_kfree(dev, new);
 err_out:
@@ -791,15 +1352,41 @@ static int ionic_qcqs_alloc(struct ionic_lif *lif)
 	if (!lif->rxqcqs)
 		goto err_out;
 
-	lif->txqstats = devm_kcalloc(dev, lif->ionic->ntxqs_per_lif + 1,
+	/* room for the hwstamp txqs and then any xdp txqs */
+	lif->txqstats = devm_kcalloc(dev, lif->ionic->ntxqs_per_lif +
+					  lif->ionic->nhwstamp_txqs_per_lif +
+					  lif->ionic->nxdp_txqs_per_lif,
 				     sizeof(*lif->txqstats), GFP_KERNEL);
 	if (!lif->txqstats)
 		goto err_out;
+#ifdef IONIC_XDP
+	if (lif->ionic->nxdp_txqs_per_lif) {
+		lif->xdp_txqcqs = devm_kcalloc(dev, lif->ionic->nxdp_txqs_per_lif,
+					       sizeof(*lif->xdp_txqcqs),
+					       GFP_KERNEL);
+		if (!lif->xdp_txqcqs)
+			goto err_out;
+	}
+#endif
 	lif->rxqstats = devm_kcalloc(dev, lif->ionic->nrxqs_per_lif + 1,
 				     sizeof(*lif->rxqstats), GFP_KERNEL);
 	if (!lif->rxqstats)
 		goto err_out;
 
+	lif->txq_coal = devm_kcalloc(dev, lif->ionic->ntxqs_per_lif,
+				     sizeof(*lif->txq_coal), GFP_KERNEL);
+	if (!lif->txq_coal)
+		goto err_out;
+	lif->rxq_coal = devm_kcalloc(dev, lif->ionic->nrxqs_per_lif,
+				     sizeof(*lif->rxq_coal), GFP_KERNEL);
+	if (!lif->rxq_coal)
+		goto err_out;
+
+	lif->qpair_rates = devm_kcalloc(dev, lif->ionic->ntxqs_per_lif,
+					sizeof(*lif->qpair_rates), GFP_KERNEL);
+	if (!lif->qpair_rates)
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -851,6 +1438,12 @@ static int ionic_lif_txq_init(struct ionic_lif *lif, struct ionic_qcq *qcq)
 		ctx.cmd.q_init.ring_base = cpu_to_le64(qcq->cmb_q_base_pa);
 	}
 
+	/* xdp txqs are polled from the rx NAPI, they raise no interrupt */
+	if (qcq->flags & IONIC_QCQ_F_XDP) {
+		ctx.cmd.q_init.flags &= cpu_to_le16(~IONIC_QINIT_F_IRQ);
+		ctx.cmd.q_init.intr_index = 0;
+	}
+
 	dev_dbg(dev, "txq_init.pid %d\n", ctx.cmd.q_init.pid);
 	dev_dbg(dev, "txq_init.index %d\n", ctx.cmd.q_init.index);
 	dev_dbg(dev, "txq_init.ring_base 0x%llx\n", ctx.cmd.q_init.ring_base);
@@ -876,11 +1469,20 @@ static int ionic_lif_txq_init(struct ionic_lif *lif, struct ionic_qcq *qcq)
 
 	q->dbell_deadline = IONIC_TX_DOORBELL_DEADLINE;
 	q->dbell_jiffies = jiffies;
+	q->dbell_idx = q->head_idx;
+	q->dbell_deferred = false;
+	q->dbell_batch = min_t(unsigned int, tx_dbell_batch,
+			       IONIC_TX_DBELL_BATCH_MAX);
+
+#ifdef IONIC_XSK
+	q->xsk_pool = ionic_lif_xsk_pool(lif, qcq);
+	q->xsk_tx_done = 0;
+#endif
 
-	if (test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state)) {
+	if (test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state) &&
+	    !(qcq->flags & IONIC_QCQ_F_XDP)) {
 		netif_napi_add(lif->netdev, &qcq->napi, ionic_tx_napi);
 		qcq->napi_qcq = qcq;
-		timer_setup(&qcq->napi_deadline, ionic_napi_deadline, 0);
 	}
 
 	qcq->flags |= IONIC_QCQ_F_INITED;
@@ -950,15 +1552,37 @@ static int ionic_lif_rxq_init(struct ionic_lif *lif, struct ionic_qcq *qcq)
 	else
 		netif_napi_add(lif->netdev, &qcq->napi, ionic_txrx_napi);
 
+#ifdef IONIC_XSK
+	q->xsk_pool = ionic_lif_xsk_pool(lif, qcq);
+#endif
+
+	/* header split needs the SG ring, and doesn't apply to AF_XDP */
+	q->hdr_split = test_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state) &&
+		       !ionic_q_xsk_pool(q) &&
+		       q->max_sg_elems;
+
+#ifdef IONIC_XDP
+	/* AF_XDP needs the rxq info even before a program shows up */
+	if ((lif->xdp_prog || ionic_q_xsk_pool(q)) &&
+	    qcq != lif->hwstamp_rxq) {
+		err = ionic_xdp_register_rxq_info(q, qcq->napi.napi_id);
+		if (err) {
+			netif_napi_del(&qcq->napi);
+			return err;
+		}
+		q->xdp_prog = lif->xdp_prog;
+	}
+#endif
+
 	qcq->napi_qcq = qcq;
-	timer_setup(&qcq->napi_deadline, ionic_napi_deadline, 0);
 
 	qcq->flags |= IONIC_QCQ_F_INITED;
 
 	return 0;
 }
 
-int ionic_lif_create_hwstamp_txq(struct ionic_lif *lif)
+static int ionic_lif_create_hwstamp_txq(struct ionic_lif *lif,
+					unsigned int i)
 {
 	unsigned int num_desc, desc_sz, comp_sz, sg_desc_sz;
 	unsigned int txq_i, flags;
@@ -966,9 +1590,6 @@ int ionic_lif_create_hwstamp_txq(struct ionic_lif *lif)
 	u64 features;
 	int err;
 
-	if (lif->hwstamp_txq)
-		return 0;
-
 	features = IONIC_Q_F_2X_CQ_DESC | IONIC_TXQ_F_HWSTAMP;
 
 	num_desc = IONIC_MIN_TXRX_DESC;
@@ -981,7 +1602,7 @@ int ionic_lif_create_hwstamp_txq(struct ionic_lif *lif)
 	else
 		sg_desc_sz = sizeof(struct ionic_txq_sg_desc);
 
-	txq_i = lif->ionic->ntxqs_per_lif;
+	txq_i = lif->ionic->ntxqs_per_lif + i;
 	flags = IONIC_QCQ_F_TX_STATS | IONIC_QCQ_F_SG;
 
 	err = ionic_qcq_alloc(lif, IONIC_QTYPE_TXQ, txq_i, "hwstamp_tx", flags,
@@ -991,11 +1612,12 @@ int ionic_lif_create_hwstamp_txq(struct ionic_lif *lif)
 		goto err_qcq_alloc;
 
 	txq->q.features = features;
+	spin_lock_init(&txq->q.hwstamp_lock);
 
 	ionic_link_qcq_interrupts(lif->adminqcq, txq);
 	ionic_debugfs_add_qcq(lif, txq);
 
-	lif->hwstamp_txq = txq;
+	lif->hwstamp_txqs[i] = txq;
 
 	if (netif_running(lif->netdev)) {
 		err = ionic_lif_txq_init(lif, txq);
@@ -1014,7 +1636,7 @@ int ionic_lif_create_hwstamp_txq(struct ionic_lif *lif)
 err_qcq_enable:
 	ionic_lif_qcq_deinit(lif, txq);
 err_qcq_init:
-	lif->hwstamp_txq = NULL;
+	lif->hwstamp_txqs[i] = NULL;
 	ionic_debugfs_del_qcq(txq);
 	ionic_qcq_free(lif, txq);
 	devm_kfree(lif->ionic->dev, txq);
@@ -1022,6 +1644,32 @@ err_qcq_alloc:
 	return err;
 }
 
+/* Timestamped packets are spread over a small pool of txqs by flow
+ * hash, so one PTP-busy queue doesn't serialize every core.  Having
+ * fewer than asked for is fine, only an empty pool is an error.
+ */
+int ionic_lif_create_hwstamp_txqs(struct ionic_lif *lif)
+{
+	unsigned int i;
+	int err = 0;
+
+	for (i = lif->nhwstamp_txqs; i < lif->ionic->nhwstamp_txqs_per_lif; i++) {
+		err = ionic_lif_create_hwstamp_txq(lif, i);
+		if (err)
+			break;
+
+		/* only published once it is ready to post on */
+		WRITE_ONCE(lif->nhwstamp_txqs, i + 1);
+	}
+
+	if (err && lif->nhwstamp_txqs)
+		netdev_info(lif->netdev, "Using %u of %u hwstamp txqs: %d\n",
+			    lif->nhwstamp_txqs,
+			    lif->ionic->nhwstamp_txqs_per_lif, err);
+
+	return lif->nhwstamp_txqs ? 0 : err;
+}
+
 int ionic_lif_create_hwstamp_rxq(struct ionic_lif *lif)
 {
 	unsigned int num_desc, desc_sz, comp_sz, sg_desc_sz;
@@ -1288,7 +1936,7 @@ static int ionic_adminq_napi(struct napi_struct *napi, int budget)
 	struct ionic_dev *idev = &lif->ionic->idev;
 	unsigned long irqflags;
 	unsigned int flags = 0;
-	bool resched = false;
+	unsigned int i;
 	int rx_work = 0;
 	int tx_work = 0;
 	int n_work = 0;
@@ -1306,13 +1954,15 @@ static int ionic_adminq_napi(struct napi_struct *napi, int budget)
 					  ionic_adminq_service, NULL, NULL);
 	spin_unlock_irqrestore(&lif->adminq_lock, irqflags);
 
-	if (lif->hwstamp_rxq)
-		rx_work = ionic_cq_service(&lif->hwstamp_rxq->cq, budget,
-					   ionic_rx_service, NULL, NULL);
+	if (lif->hwstamp_rxq) {
+		ionic_rx_node_update(&lif->hwstamp_rxq->q);
+		rx_work = ionic_rx_cq_service(&lif->hwstamp_rxq->cq, budget);
+	}
 
-	if (lif->hwstamp_txq)
-		tx_work = ionic_cq_service(&lif->hwstamp_txq->cq, budget,
-					   ionic_tx_service, NULL, NULL);
+	/* the hwstamp txqs share the one budget */
+	for (i = 0; i < lif->nhwstamp_txqs && tx_work < budget; i++)
+		tx_work += ionic_tx_cq_service(&lif->hwstamp_txqs[i]->cq,
+					       budget - tx_work, budget);
 
 	work_done = max(max(n_work, a_work), max(rx_work, tx_work));
 	if (work_done < budget && napi_complete_done(napi, work_done)) {
@@ -1326,15 +1976,12 @@ static int ionic_adminq_napi(struct napi_struct *napi, int budget)
 		ionic_intr_credits(idev->intr_ctrl, intr->index, credits, flags);
 	}
 
-	if (!a_work && ionic_adminq_poke_doorbell(&lif->adminqcq->q))
-		resched = true;
-	if (lif->hwstamp_rxq && !rx_work && ionic_rxq_poke_doorbell(&lif->hwstamp_rxq->q))
-		resched = true;
-	if (lif->hwstamp_txq && !tx_work && ionic_txq_poke_doorbell(&lif->hwstamp_txq->q))
-		resched = true;
-	if (resched)
-		mod_timer(&lif->adminqcq->napi_deadline,
-			  jiffies + IONIC_NAPI_DEADLINE);
+	if (!a_work)
+		ionic_adminq_poke_doorbell(&lif->adminqcq->q);
+	if (lif->hwstamp_rxq && !rx_work)
+		ionic_rxq_poke_doorbell(&lif->hwstamp_rxq->q);
+	for (i = 0; i < lif->nhwstamp_txqs && !tx_work; i++)
+		ionic_txq_poke_doorbell(&lif->hwstamp_txqs[i]->q);
 
 	return work_done;
 }
@@ -1737,6 +2384,11 @@ static int ionic_init_nic_features(struct ionic_lif *lif)
 	netdev->hw_features |= netdev->hw_enc_features;
 	netdev->features |= netdev->hw_features;
 
+#ifdef IONIC_GRO_HW
+	/* the driver builds the aggregates, so leave it for the user to enable */
+	netdev->hw_features |= NETIF_F_GRO_HW;
+#endif
+
 	/* some earlier kernels complain if the vlan device inherits
 	 * the NETIF_F_HW_VLAN... flags, so strip them out
 	 */
@@ -1764,6 +2416,25 @@ static int ionic_set_features(struct net_device *netdev,
 	return err;
 }
 
+#ifdef IONIC_GRO_HW
+static netdev_features_t ionic_fix_features(struct net_device *netdev,
+					    netdev_features_t features)
+{
+#ifdef IONIC_XDP
+	struct ionic_lif *lif = netdev_priv(netdev);
+
+	/* an XDP program wants to see every frame as it came off the wire */
+	if (lif->xdp_prog)
+		features &= ~NETIF_F_GRO_HW;
+#endif
+	/* aggregates are only built from checksum-verified segments */
+	if (!(features & NETIF_F_RXCSUM))
+		features &= ~NETIF_F_GRO_HW;
+
+	return features;
+}
+#endif
+
 static int ionic_set_attr_mac(struct ionic_lif *lif, u8 *mac)
 {
 	struct ionic_admin_ctx ctx = {
@@ -1885,6 +2556,18 @@ static int ionic_start_queues_reconfig(struct ionic_lif *lif)
 	return err;
 }
 
+#ifdef IONIC_XDP
+/* Frames past one page need a program that understands frags */
+static bool ionic_xdp_mtu_ok(struct bpf_prog *prog, unsigned int mtu)
+{
+#ifdef IONIC_XDP_MB
+	if (prog->aux->xdp_has_frags)
+		return true;
+#endif
+	return mtu <= IONIC_XDP_MAX_LINEAR_MTU;
+}
+
+#endif
 static int ionic_change_mtu(struct net_device *netdev, int new_mtu)
 {
 	struct ionic_lif *lif = netdev_priv(netdev);
@@ -1907,6 +2590,28 @@ static int ionic_change_mtu(struct net_device *netdev, int new_mtu)
 		return -EINVAL;
 	}
 
+#ifdef IONIC_XDP
+	if (lif->xdp_prog && !ionic_xdp_mtu_ok(lif->xdp_prog, new_mtu)) {
+		netdev_err(netdev, "MTU %d too large for XDP, max %lu\n",
+			   new_mtu, IONIC_XDP_MAX_LINEAR_MTU);
+		return -EINVAL;
+	}
+#endif
+#ifdef IONIC_XSK
+	if (lif->xsk_pools) {
+		unsigned int i;
+
+		for (i = 0; i < lif->ionic->nrxqs_per_lif; i++) {
+			if (lif->xsk_pools[i] &&
+			    xsk_pool_get_rx_frame_size(lif->xsk_pools[i]) < fs) {
+				netdev_err(netdev, "MTU %d too large for XSK frames on queue %d\n",
+					   new_mtu, i);
+				return -EINVAL;
+			}
+		}
+	}
+#endif
+
 	err = ionic_adminq_post_wait(lif, &ctx);
 	if (err)
 		return err;
@@ -1929,6 +2634,206 @@ static int ionic_change_mtu(struct net_device *netdev, int new_mtu)
 	return err;
 }
 
+#ifdef IONIC_XDP
+static int ionic_xdp_config(struct net_device *netdev, struct netdev_bpf *bpf)
+{
+	struct ionic_lif *lif = netdev_priv(netdev);
+	struct bpf_prog *old_prog;
+	unsigned int i;
+	int err = 0;
+
+	if (bpf->prog && !ionic_xdp_mtu_ok(bpf->prog, netdev->mtu)) {
+		netdev_info(netdev, "%d is too big for XDP, max %lu\n",
+			    netdev->mtu, IONIC_XDP_MAX_LINEAR_MTU);
+		NL_SET_ERR_MSG_MOD(bpf->extack, "MTU is too large for XDP");
+		return -EOPNOTSUPP;
+	}
+
+	if (bpf->prog && test_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state)) {
+		netdev_info(netdev, "XDP not supported with Rx header split\n");
+		NL_SET_ERR_MSG_MOD(bpf->extack, "Disable tcp-data-split for XDP");
+		return -EOPNOTSUPP;
+	}
+
+	if (!netif_running(netdev)) {
+		old_prog = xchg(&lif->xdp_prog, bpf->prog);
+	} else if (lif->xdp_prog && bpf->prog) {
+		/* buffer layout doesn't change, just swap the program */
+		old_prog = xchg(&lif->xdp_prog, bpf->prog);
+		for (i = 0; i < lif->nxqs; i++)
+			WRITE_ONCE(lif->rxqcqs[i]->q.xdp_prog, bpf->prog);
+	} else {
+		/* rx buffers need (or no longer need) the XDP headroom,
+		 * and the xdp txqs come and go with the program
+		 */
+		mutex_lock(&lif->queue_lock);
+		ionic_stop_queues_reconfig(lif);
+		old_prog = xchg(&lif->xdp_prog, bpf->prog);
+		if (bpf->prog)
+			ionic_xdp_txqs_alloc(lif);
+		else
+			ionic_xdp_txqs_free(lif);
+		err = ionic_start_queues_reconfig(lif);
+		mutex_unlock(&lif->queue_lock);
+	}
+
+#ifdef IONIC_GRO_HW
+	/* NETIF_F_GRO_HW comes and goes with the program */
+	if (!old_prog != !bpf->prog)
+		netdev_update_features(netdev);
+#endif
+
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return err;
+}
+
+#ifdef IONIC_XSK
+/* Bounce a single tx/rx queue pair without disturbing the rest of the
+ * LIF, used to switch a queue in or out of AF_XDP zero-copy mode.
+ */
+static int ionic_restart_qpair(struct ionic_lif *lif, unsigned int qi)
+{
+	struct ionic_qcq *txqcq, *rxqcq;
+	struct netdev_queue *nq;
+	bool up;
+	int err;
+
+	if (!netif_running(lif->netdev) || qi >= lif->nxqs ||
+	    !lif->txqcqs || !lif->rxqcqs)
+		return 0;
+
+	txqcq = lif->txqcqs[qi];
+	rxqcq = lif->rxqcqs[qi];
+	if (!txqcq || !rxqcq)
+		return 0;
+
+	up = test_bit(IONIC_LIF_F_UP, lif->state);
+	nq = netdev_get_tx_queue(lif->netdev, qi);
+
+	if (up) {
+		__netif_tx_lock_bh(nq);
+		netif_tx_stop_queue(nq);
+		__netif_tx_unlock_bh(nq);
+
+		err = ionic_qcq_disable(lif, rxqcq, 0);
+		err = ionic_qcq_disable(lif, txqcq, err);
+		if (err == -ETIMEDOUT || err == -ENXIO)
+			return err;
+	}
+
+	ionic_lif_qcq_deinit(lif, txqcq);
+	ionic_tx_flush(&txqcq->cq);
+	ionic_tx_empty(&txqcq->q);
+	ionic_lif_qcq_deinit(lif, rxqcq);
+	ionic_rx_empty(&rxqcq->q);
+
+	err = ionic_lif_txq_init(lif, txqcq);
+	if (err)
+		return err;
+
+	err = ionic_lif_rxq_init(lif, rxqcq);
+	if (err)
+		goto err_out_txq;
+
+	if (!up)
+		return 0;
+
+	ionic_rx_fill(&rxqcq->q);
+	err = ionic_qcq_enable(rxqcq);
+	if (err)
+		goto err_out_rxq;
+
+	err = ionic_qcq_enable(txqcq);
+	if (err) {
+		ionic_qcq_disable(lif, rxqcq, err);
+		goto err_out_rxq;
+	}
+
+	netif_tx_wake_queue(nq);
+
+	return 0;
+
+err_out_rxq:
+	ionic_lif_qcq_deinit(lif, rxqcq);
+	ionic_rx_empty(&rxqcq->q);
+err_out_txq:
+	ionic_lif_qcq_deinit(lif, txqcq);
+	netdev_err(lif->netdev, "Failed to restart queue pair %d: %d\n",
+		   qi, err);
+	return err;
+}
+
+static int ionic_xsk_pool_setup(struct net_device *netdev,
+				struct xsk_buff_pool *pool, u16 qid)
+{
+	struct ionic_lif *lif = netdev_priv(netdev);
+	struct device *dev = lif->ionic->dev;
+	struct xsk_buff_pool *old_pool;
+	int err;
+
+	/* let a pool go even if its queue has been taken out of use */
+	if (qid >= (pool ? lif->nxqs : lif->ionic->nrxqs_per_lif))
+		return -EINVAL;
+
+	if (!lif->xsk_pools) {
+		lif->xsk_pools = devm_kcalloc(dev, lif->ionic->nrxqs_per_lif,
+					      sizeof(*lif->xsk_pools),
+					      GFP_KERNEL);
+		if (!lif->xsk_pools)
+			return -ENOMEM;
+	}
+
+	if (pool) {
+		/* each packet has to land in a single UMEM frame */
+		if (xsk_pool_get_rx_frame_size(pool) <
+		    netdev->mtu + ETH_HLEN + VLAN_HLEN) {
+			netdev_err(netdev, "XSK frame size %u too small for MTU %d\n",
+				   xsk_pool_get_rx_frame_size(pool),
+				   netdev->mtu);
+			return -EOPNOTSUPP;
+		}
+
+		err = xsk_pool_dma_map(pool, dev, 0);
+		if (err)
+			return err;
+	}
+
+	mutex_lock(&lif->queue_lock);
+	old_pool = lif->xsk_pools[qid];
+	lif->xsk_pools[qid] = pool;
+	err = ionic_restart_qpair(lif, qid);
+	if (err && pool)
+		lif->xsk_pools[qid] = NULL;
+	mutex_unlock(&lif->queue_lock);
+
+	/* the queue pair is quiet, now the old mapping can go */
+	if (old_pool)
+		xsk_pool_dma_unmap(old_pool, 0);
+	if (err && pool)
+		xsk_pool_dma_unmap(pool, 0);
+
+	return err;
+}
+#endif /* IONIC_XSK */
+
+static int ionic_bpf(struct net_device *netdev, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return ionic_xdp_config(netdev, bpf);
+#ifdef IONIC_XSK
+	case XDP_SETUP_XSK_POOL:
+		return ionic_xsk_pool_setup(netdev, bpf->xsk.pool,
+					    bpf->xsk.queue_id);
+#endif
+	default:
+		return -EINVAL;
+	}
+}
+#endif /* IONIC_XDP */
+
 static void ionic_tx_timeout_work(struct work_struct *ws)
 {
 	struct ionic_lif *lif = container_of(ws, struct ionic_lif, tx_timeout_work);
@@ -2075,6 +2980,66 @@ static void ionic_lif_quiesce(struct ionic_lif *lif)
 		netdev_dbg(lif->netdev, "lif quiesce failed %d\n", err);
 }
 
+#ifdef IONIC_XDP
+static void ionic_xdp_txqs_free(struct ionic_lif *lif)
+{
+	unsigned int i;
+
+	for (i = 0; i < lif->nxdp_txqs; i++) {
+		ionic_qcq_free(lif, lif->xdp_txqcqs[i]);
+		devm_kfree(lif->ionic->dev, lif->xdp_txqcqs[i]);
+		lif->xdp_txqcqs[i] = NULL;
+	}
+	lif->nxdp_txqs = 0;
+}
+
+/* Best effort: without its own txqs XDP shares the stack's, under the
+ * netdev tx queue lock.
+ */
+static void ionic_xdp_txqs_alloc(struct ionic_lif *lif)
+{
+	unsigned int sg_desc_sz, txq_i, flags, i;
+	int err;
+
+	if (!lif->xdp_txqcqs || lif->nxdp_txqs)
+		return;
+
+	if (lif->qtype_info[IONIC_QTYPE_TXQ].version >= 1 &&
+	    lif->qtype_info[IONIC_QTYPE_TXQ].sg_desc_sz ==
+					  sizeof(struct ionic_txq_sg_desc_v1))
+		sg_desc_sz = sizeof(struct ionic_txq_sg_desc_v1);
+	else
+		sg_desc_sz = sizeof(struct ionic_txq_sg_desc);
+
+	/* no interrupt, the completions are reaped from the rx NAPI
+	 * and the dbell sweep
+	 */
+	flags = IONIC_QCQ_F_TX_STATS | IONIC_QCQ_F_SG | IONIC_QCQ_F_XDP;
+
+	/* just past the hwstamp txqs */
+	txq_i = lif->ionic->ntxqs_per_lif + lif->ionic->nhwstamp_txqs_per_lif;
+
+	for (i = 0; i < lif->ionic->nxdp_txqs_per_lif; i++) {
+		err = ionic_qcq_alloc(lif, IONIC_QTYPE_TXQ, txq_i + i, "xdp_tx",
+				      flags, lif->ntxq_descs,
+				      sizeof(struct ionic_txq_desc),
+				      sizeof(struct ionic_txq_comp),
+				      sg_desc_sz, lif->kern_pid,
+				      &lif->xdp_txqcqs[i]);
+		if (err) {
+			netdev_warn(lif->netdev, "Cannot allocate xdp txqs, sharing the stack's: %d\n",
+				    err);
+			ionic_xdp_txqs_free(lif);
+			return;
+		}
+
+		spin_lock_init(&lif->xdp_txqcqs[i]->q.xdp_lock);
+		ionic_debugfs_add_qcq(lif, lif->xdp_txqcqs[i]);
+		lif->nxdp_txqs++;
+	}
+}
+#endif
+
 static void ionic_txrx_disable(struct ionic_lif *lif)
 {
 	unsigned int i;
@@ -2085,8 +3050,13 @@ static void ionic_txrx_disable(struct ionic_lif *lif)
 			err = ionic_qcq_disable(lif, lif->txqcqs[i], err);
 	}
 
-	if (lif->hwstamp_txq)
-		err = ionic_qcq_disable(lif, lif->hwstamp_txq, err);
+	for (i = 0; i < lif->nhwstamp_txqs; i++)
+		err = ionic_qcq_disable(lif, lif->hwstamp_txqs[i], err);
+
+#ifdef IONIC_XDP
+	for (i = 0; i < lif->nxdp_txqs; i++)
+		err = ionic_qcq_disable(lif, lif->xdp_txqcqs[i], err);
+#endif
 
 	if (lif->rxqcqs) {
 		for (i = 0; i < lif->nxqs; i++)
@@ -2119,12 +3089,20 @@ static void ionic_txrx_deinit(struct ionic_lif *lif)
 	}
 	lif->rx_mode = 0;
 
-	if (lif->hwstamp_txq) {
-		ionic_lif_qcq_deinit(lif, lif->hwstamp_txq);
-		ionic_tx_flush(&lif->hwstamp_txq->cq);
-		ionic_tx_empty(&lif->hwstamp_txq->q);
+	for (i = 0; i < lif->nhwstamp_txqs; i++) {
+		ionic_lif_qcq_deinit(lif, lif->hwstamp_txqs[i]);
+		ionic_tx_flush(&lif->hwstamp_txqs[i]->cq);
+		ionic_tx_empty(&lif->hwstamp_txqs[i]->q);
 	}
 
+#ifdef IONIC_XDP
+	for (i = 0; i < lif->nxdp_txqs; i++) {
+		ionic_lif_qcq_deinit(lif, lif->xdp_txqcqs[i]);
+		ionic_tx_flush(&lif->xdp_txqcqs[i]->cq);
+		ionic_tx_empty(&lif->xdp_txqcqs[i]->q);
+	}
+#endif
+
 	if (lif->hwstamp_rxq) {
 		ionic_lif_qcq_deinit(lif, lif->hwstamp_rxq);
 		ionic_rx_empty(&lif->hwstamp_rxq->q);
@@ -2151,17 +3129,22 @@ static void ionic_txrx_free(struct ionic_lif *lif)
 		}
 	}
 
-	if (lif->hwstamp_txq) {
-		ionic_qcq_free(lif, lif->hwstamp_txq);
-		devm_kfree(lif->ionic->dev, lif->hwstamp_txq);
-		lif->hwstamp_txq = NULL;
+	for (i = 0; i < lif->nhwstamp_txqs; i++) {
+		ionic_qcq_free(lif, lif->hwstamp_txqs[i]);
+		devm_kfree(lif->ionic->dev, lif->hwstamp_txqs[i]);
+		lif->hwstamp_txqs[i] = NULL;
 	}
+	lif->nhwstamp_txqs = 0;
 
 	if (lif->hwstamp_rxq) {
 		ionic_qcq_free(lif, lif->hwstamp_rxq);
 		devm_kfree(lif->ionic->dev, lif->hwstamp_rxq);
 		lif->hwstamp_rxq = NULL;
 	}
+
+#ifdef IONIC_XDP
+	ionic_xdp_txqs_free(lif);
+#endif
 }
 
 static int ionic_txrx_alloc(struct ionic_lif *lif)
@@ -2186,6 +3169,9 @@ static int ionic_txrx_alloc(struct ionic_lif *lif)
 	if (test_bit(IONIC_LIF_F_CMB_TX_RINGS, lif->state))
 		flags |= IONIC_QCQ_F_CMB_RINGS;
 
+	if (test_bit(IONIC_LIF_F_TX_BOUNCE, lif->state))
+		flags |= IONIC_QCQ_F_TX_BOUNCE;
+
 	if (test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state))
 		flags |= IONIC_QCQ_F_INTR;
 
@@ -2196,13 +3182,7 @@ static int ionic_txrx_alloc(struct ionic_lif *lif)
 		if (err)
 			goto err_out;
 
-		if (flags & IONIC_QCQ_F_INTR) {
-			ionic_intr_coal_init(lif->ionic->idev.intr_ctrl,
-					     lif->txqcqs[i]->intr.index,
-					     lif->tx_coalesce_hw);
-			if (test_bit(IONIC_LIF_F_TX_DIM_INTR, lif->state))
-				lif->txqcqs[i]->intr.dim_coal_hw = lif->tx_coalesce_hw;
-		}
+		ionic_lif_qcq_coal_init(lif, lif->txqcqs[i]);
 
 		ionic_debugfs_add_qcq(lif, lif->txqcqs[i]);
 	}
@@ -2229,11 +3209,7 @@ static int ionic_txrx_alloc(struct ionic_lif *lif)
 
 		lif->rxqcqs[i]->q.features = lif->rxq_features;
 
-		ionic_intr_coal_init(lif->ionic->idev.intr_ctrl,
-				     lif->rxqcqs[i]->intr.index,
-				     lif->rx_coalesce_hw);
-		if (test_bit(IONIC_LIF_F_RX_DIM_INTR, lif->state))
-			lif->rxqcqs[i]->intr.dim_coal_hw = lif->rx_coalesce_hw;
+		ionic_lif_qcq_coal_init(lif, lif->rxqcqs[i]);
 
 		if (!test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state))
 			ionic_link_qcq_interrupts(lif->rxqcqs[i],
@@ -2242,6 +3218,11 @@ static int ionic_txrx_alloc(struct ionic_lif *lif)
 		ionic_debugfs_add_qcq(lif, lif->rxqcqs[i]);
 	}
 
+#ifdef IONIC_XDP
+	if (lif->xdp_prog)
+		ionic_xdp_txqs_alloc(lif);
+#endif
+
 	lif->n_txrx_alloc++;
 
 	return 0;
@@ -2269,6 +3250,26 @@ static int ionic_txrx_init(struct ionic_lif *lif)
 		}
 	}
 
+	/* the stack drops the XPS maps of txqs past real_num_tx_queues */
+	for (i = 0; i < lif->ionic->ntxqs_per_lif; i++) {
+		if (i < lif->nxqs)
+			ionic_lif_set_xps(lif, i);
+		else
+			cpumask_clear(&lif->xps_masks[i]);
+	}
+
+#ifdef IONIC_XDP
+	for (i = 0; i < lif->nxdp_txqs; i++) {
+		err = ionic_lif_txq_init(lif, lif->xdp_txqcqs[i]);
+		if (err) {
+			while (i--)
+				ionic_lif_qcq_deinit(lif, lif->xdp_txqcqs[i]);
+			i = lif->nxqs;
+			goto err_out;
+		}
+	}
+#endif
+
 	if (lif->netdev->features & NETIF_F_RXHASH)
 		ionic_lif_rss_init(lif);
 
@@ -2316,14 +3317,36 @@ static int ionic_txrx_enable(struct ionic_lif *lif)
 			goto err_out_hwstamp_rx;
 	}
 
-	if (lif->hwstamp_txq) {
-		err = ionic_qcq_enable(lif->hwstamp_txq);
-		if (err)
+	for (i = 0; i < lif->nhwstamp_txqs; i++) {
+		err = ionic_qcq_enable(lif->hwstamp_txqs[i]);
+		if (err) {
+			while (i--)
+				derr = ionic_qcq_disable(lif,
+							 lif->hwstamp_txqs[i],
+							 derr);
 			goto err_out_hwstamp_tx;
+		}
+	}
+
+#ifdef IONIC_XDP
+	for (i = 0; i < lif->nxdp_txqs; i++) {
+		err = ionic_qcq_enable(lif->xdp_txqcqs[i]);
+		if (err) {
+			while (i--)
+				derr = ionic_qcq_disable(lif, lif->xdp_txqcqs[i],
+							 derr);
+			goto err_out_xdp_tx;
+		}
 	}
+#endif
 
 	return 0;
 
+#ifdef IONIC_XDP
+err_out_xdp_tx:
+	for (i = 0; i < lif->nhwstamp_txqs; i++)
+		derr = ionic_qcq_disable(lif, lif->hwstamp_txqs[i], derr);
+#endif
 err_out_hwstamp_tx:
 	if (lif->hwstamp_rxq)
 		derr = ionic_qcq_disable(lif, lif->hwstamp_rxq, derr);
@@ -2812,6 +3835,9 @@ static const struct net_device_ops ionic_netdev_ops = {
 	.ndo_get_stats64	= ionic_get_stats64,
 	.ndo_set_rx_mode	= ionic_ndo_set_rx_mode,
 	.ndo_set_features	= ionic_set_features,
+#ifdef IONIC_GRO_HW
+	.ndo_fix_features	= ionic_fix_features,
+#endif
 	.ndo_set_mac_address	= ionic_set_mac_address,
 	.ndo_validate_addr	= eth_validate_addr,
 #ifdef HAVE_RHEL7_EXTENDED_MIN_MAX_MTU
@@ -2842,6 +3868,13 @@ static const struct net_device_ops ionic_netdev_ops = {
 	.ndo_get_vf_config	= ionic_get_vf_config,
 	.ndo_set_vf_link_state	= ionic_set_vf_link_state,
 	.ndo_get_vf_stats       = ionic_get_vf_stats,
+#ifdef IONIC_XDP
+	.ndo_bpf		= ionic_bpf,
+	.ndo_xdp_xmit		= ionic_xdp_xmit,
+#endif
+#ifdef IONIC_XSK
+	.ndo_xsk_wakeup		= ionic_xsk_wakeup,
+#endif
 
 #ifdef HAVE_RHEL7_NET_DEVICE_OPS_EXT
 /* RHEL7 requires this to be defined to enable extended ops.  RHEL7 uses the
@@ -2861,6 +3894,9 @@ static const struct net_device_ops ionic_mnic_netdev_ops = {
 	.ndo_get_stats64	= ionic_get_stats64,
 	.ndo_set_rx_mode	= ionic_ndo_set_rx_mode,
 	.ndo_set_features	= ionic_set_features,
+#ifdef IONIC_GRO_HW
+	.ndo_fix_features	= ionic_fix_features,
+#endif
 	.ndo_set_mac_address	= ionic_set_mac_address,
 	.ndo_validate_addr	= eth_validate_addr,
 	.ndo_tx_timeout         = ionic_tx_timeout,
@@ -2960,6 +3996,19 @@ static void ionic_swap_queues(struct ionic_qcq *a, struct ionic_qcq *b)
 	swap(a->cq_base_pa,   b->cq_base_pa);
 	swap(a->cq_size,      b->cq_size);
 
+	/* the bounce area was sized for the new ring */
+	swap(a->tx_bounce_page,   b->tx_bounce_page);
+	swap(a->tx_bounce_base,   b->tx_bounce_base);
+	swap(a->tx_bounce_dma,    b->tx_bounce_dma);
+	swap(a->tx_bounce_size,   b->tx_bounce_size);
+	swap(a->tx_bounce_order,  b->tx_bounce_order);
+	swap(a->tx_bounce_slots,  b->tx_bounce_slots);
+
+#ifdef IONIC_PAGE_POOL
+	/* the pool was sized for the new ring */
+	swap(a->q.page_pool,  b->q.page_pool);
+#endif
+
 	ionic_debugfs_del_qcq(a);
 	ionic_debugfs_add_qcq(a->q.lif, a);
 }
@@ -3100,6 +4149,8 @@ int ionic_reconfigure_queues(struct ionic_lif *lif,
 			clear_bit(IONIC_LIF_F_SPLIT_INTR, lif->state);
 			lif->tx_coalesce_usecs = lif->rx_coalesce_usecs;
 			lif->tx_coalesce_hw = lif->rx_coalesce_hw;
+			memset(lif->txq_coal, 0, lif->ionic->ntxqs_per_lif *
+						 sizeof(*lif->txq_coal));
 		}
 
 		/* Clear existing interrupt assignments.  We check for NULL here
@@ -3117,18 +4168,12 @@ int ionic_reconfigure_queues(struct ionic_lif *lif,
 		for (i = 0; i < qparam->nxqs; i++) {
 			lif->rxqcqs[i]->flags |= IONIC_QCQ_F_INTR;
 			err = ionic_alloc_qcq_interrupt(lif, lif->rxqcqs[i]);
-			ionic_intr_coal_init(lif->ionic->idev.intr_ctrl,
-					     lif->rxqcqs[i]->intr.index,
-					     lif->rx_coalesce_hw);
+			ionic_lif_qcq_coal_init(lif, lif->rxqcqs[i]);
 
 			if (qparam->intr_split) {
 				lif->txqcqs[i]->flags |= IONIC_QCQ_F_INTR;
 				err = ionic_alloc_qcq_interrupt(lif, lif->txqcqs[i]);
-				ionic_intr_coal_init(lif->ionic->idev.intr_ctrl,
-						     lif->txqcqs[i]->intr.index,
-						     lif->tx_coalesce_hw);
-				if (test_bit(IONIC_LIF_F_TX_DIM_INTR, lif->state))
-					lif->txqcqs[i]->intr.dim_coal_hw = lif->tx_coalesce_hw;
+				ionic_lif_qcq_coal_init(lif, lif->txqcqs[i]);
 			} else {
 				lif->txqcqs[i]->flags &= ~IONIC_QCQ_F_INTR;
 				ionic_link_qcq_interrupts(lif->rxqcqs[i], lif->txqcqs[i]);
@@ -3136,6 +4181,12 @@ int ionic_reconfigure_queues(struct ionic_lif *lif,
 		}
 	}
 
+	/* rxq_init picks this up when the queues are restarted */
+	if (qparam->hdr_split)
+		set_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state);
+	else
+		clear_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state);
+
 	/* now we can rework the debugfs mappings */
 	if (tx_qcqs) {
 		for (i = 0; i < qparam->nxqs; i++) {
@@ -3209,6 +4260,104 @@ err_out:
 	return err;
 }
 
+static u64 ionic_intr_auto_rate(u64 now_pkts, u64 *last_pkts,
+				unsigned long dt)
+{
+	u64 delta = now_pkts >= *last_pkts ? now_pkts - *last_pkts : 0;
+
+	*last_pkts = now_pkts;
+
+	return div64_u64(delta * HZ, dt);
+}
+
+/* Automatic interrupt mode, run from the watchdog's deferred work.
+ * Split interrupts pay off once both directions of most active queue
+ * pairs are busy enough to want a poll and a CPU of their own;
+ * otherwise one shared interrupt per pair means fewer wakeups.  Since
+ * switching rebuilds the queues, the wanted mode is only applied once
+ * traffic on the lif has gone quiet.
+ */
+void ionic_lif_intr_mode_check(struct ionic_lif *lif)
+{
+	struct ionic_queue_params qparam;
+	unsigned int active = 0, busy = 0;
+	struct ionic_qpair_rate *qr;
+	unsigned long now, dt;
+	u64 total = 0;
+	unsigned int i;
+	bool split;
+	int err;
+
+	/* reconfiguring needs the rtnl; if it's busy, sample next time */
+	if (!rtnl_trylock())
+		return;
+	mutex_lock(&lif->queue_lock);
+
+	if (!test_bit(IONIC_LIF_F_AUTO_SPLIT_INTR, lif->state) ||
+	    !test_bit(IONIC_LIF_F_UP, lif->state) ||
+	    test_bit(IONIC_LIF_F_FW_RESET, lif->state))
+		goto out_unlock;
+
+	now = jiffies;
+	dt = now - lif->intr_auto_jiffies;
+	for (i = 0; i < lif->nxqs; i++) {
+		qr = &lif->qpair_rates[i];
+		qr->tx_pps = ionic_intr_auto_rate(lif->txqstats[i].pkts,
+						  &qr->tx_pkts, dt ? dt : 1);
+		qr->rx_pps = ionic_intr_auto_rate(lif->rxqstats[i].pkts,
+						  &qr->rx_pkts, dt ? dt : 1);
+
+		total += qr->tx_pps + qr->rx_pps;
+		if (qr->tx_pps + qr->rx_pps >= IONIC_INTR_AUTO_ACTIVE_PPS)
+			active++;
+		if (min(qr->tx_pps, qr->rx_pps) >= IONIC_INTR_AUTO_SPLIT_PPS)
+			busy++;
+	}
+
+	/* the first pass only takes the baseline */
+	if (!lif->intr_auto_jiffies) {
+		lif->intr_auto_jiffies = now;
+		goto out_unlock;
+	}
+	lif->intr_auto_jiffies = now;
+
+	split = test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state);
+
+	/* between the thresholds, keep wanting what we wanted before */
+	if (active && busy * 2 > active)
+		lif->intr_auto_split = true;
+	else if (active && !busy)
+		lif->intr_auto_split = false;
+
+	/* split needs an interrupt per queue, as for ethtool -L rx N tx N */
+	if (lif->nxqs > lif->ionic->ntxqs_per_lif / 2)
+		lif->intr_auto_split = false;
+
+	if (lif->intr_auto_split == split || total >= IONIC_INTR_AUTO_QUIET_PPS)
+		goto out_unlock;
+
+	ionic_init_queue_params(lif, &qparam);
+	qparam.intr_split = lif->intr_auto_split;
+
+	netdev_info(lif->netdev, "%s queue interrupts\n",
+		    qparam.intr_split ? "Splitting" : "Sharing");
+
+	err = ionic_reconfigure_queues(lif, &qparam);
+	if (err) {
+		/* don't keep trying something that doesn't work */
+		clear_bit(IONIC_LIF_F_AUTO_SPLIT_INTR, lif->state);
+		netdev_info(lif->netdev, "Automatic interrupt mode disabled: %d\n",
+			    err);
+	} else {
+		lif->intr_auto_switches++;
+	}
+	lif->intr_auto_jiffies = 0;
+
+out_unlock:
+	mutex_unlock(&lif->queue_lock);
+	rtnl_unlock();
+}
+
 int ionic_lif_alloc(struct ionic *ionic)
 {
 	struct device *dev = ionic->dev;
@@ -3240,6 +4389,21 @@ int ionic_lif_alloc(struct ionic *ionic)
 		netdev->netdev_ops = &ionic_mnic_netdev_ops;
 	else
 		netdev->netdev_ops = &ionic_netdev_ops;
+#ifdef IONIC_XDP
+	if (netdev->netdev_ops == &ionic_netdev_ops)
+		netdev->xdp_features = NETDEV_XDP_ACT_BASIC |
+				       NETDEV_XDP_ACT_REDIRECT |
+				       NETDEV_XDP_ACT_NDO_XMIT |
+				       NETDEV_XDP_ACT_NDO_XMIT_SG;
+#endif
+#ifdef IONIC_XDP_MB
+	if (netdev->netdev_ops == &ionic_netdev_ops)
+		netdev->xdp_features |= NETDEV_XDP_ACT_RX_SG;
+#endif
+#ifdef IONIC_XSK
+	if (netdev->netdev_ops == &ionic_netdev_ops)
+		netdev->xdp_features |= NETDEV_XDP_ACT_XSK_ZEROCOPY;
+#endif
 
 	ionic_ethtool_set_ops(netdev);
 	netdev->watchdog_timeo = 2 * HZ;
@@ -3285,6 +4449,8 @@ int ionic_lif_alloc(struct ionic *ionic)
 	lif->tx_coalesce_hw = lif->rx_coalesce_hw;
 	set_bit(IONIC_LIF_F_RX_DIM_INTR, lif->state);
 	set_bit(IONIC_LIF_F_TX_DIM_INTR, lif->state);
+	ionic_dim_profile_to_hw(lif, ionic_dim_rx_usecs, lif->dim_rx_hw);
+	ionic_dim_profile_to_hw(lif, ionic_dim_tx_usecs, lif->dim_tx_hw);
 
 	snprintf(lif->name, sizeof(lif->name), "lif%u", lif->index);
 
@@ -3292,12 +4458,22 @@ int ionic_lif_alloc(struct ionic *ionic)
 	mutex_init(&lif->config_lock);
 	mutex_init(&lif->dbid_inuse_lock);
 
+	INIT_DELAYED_WORK(&lif->dbell_sweep, ionic_dbell_sweep);
+
 	spin_lock_init(&lif->adminq_lock);
 
 	spin_lock_init(&lif->deferred.lock);
 	INIT_LIST_HEAD(&lif->deferred.list);
 	INIT_WORK(&lif->deferred.work, ionic_lif_deferred_work);
 
+	/* kept across fw resets, as the netdev's XPS maps are */
+	lif->xps_masks = kcalloc(ionic->ntxqs_per_lif, sizeof(*lif->xps_masks),
+				 GFP_KERNEL);
+	if (!lif->xps_masks) {
+		err = -ENOMEM;
+		goto err_out_free_mutex;
+	}
+
 	/* allocate lif info */
 	lif->info_sz = ALIGN(sizeof(*lif->info), PAGE_SIZE);
 	lif->info = dma_alloc_coherent(dev, lif->info_sz,
@@ -3305,7 +4481,7 @@ int ionic_lif_alloc(struct ionic *ionic)
 	if (!lif->info) {
 		dev_err(dev, "Failed to allocate lif info, aborting\n");
 		err = -ENOMEM;
-		goto err_out_free_mutex;
+		goto err_out_free_xps;
 	}
 
 	ionic_debugfs_add_lif(lif);
@@ -3340,6 +4516,9 @@ err_out_free_lif_info:
 	dma_free_coherent(dev, lif->info_sz, lif->info, lif->info_pa);
 	lif->info = NULL;
 	lif->info_pa = 0;
+err_out_free_xps:
+	kfree(lif->xps_masks);
+	lif->xps_masks = NULL;
 err_out_free_mutex:
 	mutex_destroy(&lif->config_lock);
 	mutex_destroy(&lif->queue_lock);
@@ -3496,6 +4675,8 @@ void ionic_lif_free(struct ionic_lif *lif)
 
 	/* free lif info */
 	kfree(lif->identity);
+	kfree(lif->xps_masks);
+	lif->xps_masks = NULL;
 	dma_free_coherent(dev, lif->info_sz, lif->info, lif->info_pa);
 	lif->info = NULL;
 	lif->info_pa = 0;
@@ -3527,6 +4708,7 @@ void ionic_lif_deinit(struct ionic_lif *lif)
 			ionic_lif_rss_deinit(lif);
 	}
 
+	cancel_delayed_work_sync(&lif->dbell_sweep);
 	napi_disable(&lif->adminqcq->napi);
 	ionic_lif_qcq_deinit(lif, lif->notifyqcq);
 	ionic_lif_qcq_deinit(lif, lif->adminqcq);
@@ -3572,9 +4754,11 @@ static int ionic_lif_adminq_init(struct ionic_lif *lif)
 	netif_napi_add(lif->netdev, &qcq->napi, ionic_adminq_napi);
 
 	qcq->napi_qcq = qcq;
-	timer_setup(&qcq->napi_deadline, ionic_napi_deadline, 0);
 
 	napi_enable(&qcq->napi);
+	ionic_napi_thread_pin(qcq);
+	queue_delayed_work(system_freezable_wq, &lif->dbell_sweep,
+			   IONIC_NAPI_DEADLINE);
 
 	if (qcq->flags & IONIC_QCQ_F_INTR)
 		ionic_intr_mask(idev->intr_ctrl, qcq->intr.index,
@@ -3782,6 +4966,7 @@ int ionic_lif_init(struct ionic_lif *lif)
 	return 0;
 
 err_out_notifyq_deinit:
+	cancel_delayed_work_sync(&lif->dbell_sweep);
 	napi_disable(&lif->adminqcq->napi);
 	ionic_lif_qcq_deinit(lif, lif->notifyqcq);
 err_out_adminq_deinit:
@@ -4017,6 +5202,7 @@ int ionic_lif_size(struct ionic *ionic)
 	unsigned int nnqs_per_lif;
 	unsigned int min_intrs;
 	unsigned int nrdma_eqs;
+	unsigned int dev_ntxqs;
 	unsigned int nxqs;
 	int err;
 
@@ -4036,6 +5222,7 @@ int ionic_lif_size(struct ionic *ionic)
 		ntxqs_per_lif = 1;
 		nrxqs_per_lif = 1;
 	}
+	dev_ntxqs = ntxqs_per_lif;
 
 	/* Queue counts are driven by CPU count and interrupt availability.
 	 * In the best case, we'd like to have an individual interrupt
@@ -4094,6 +5281,20 @@ try_again:
 	ionic->ntxqs_per_lif = nxqs;
 	ionic->nrxqs_per_lif = nxqs;
 	ionic->nintrs = nintrs;
+
+	/* Tx queues past the TxRx pairs go first to a small pool of
+	 * hwstamp txqs, and what is left can serve XDP, one per CPU if
+	 * there are enough.  The XDP ones are polled, no interrupts.
+	 */
+	dev_ntxqs -= min(dev_ntxqs, nxqs);
+	if (lc->features & cpu_to_le64(IONIC_ETH_HW_TIMESTAMP))
+		ionic->nhwstamp_txqs_per_lif = min3(dev_ntxqs,
+						    (unsigned int)IONIC_MAX_HWSTAMP_TXQS,
+						    num_online_cpus());
+	else
+		ionic->nhwstamp_txqs_per_lif = 0;
+	dev_ntxqs -= ionic->nhwstamp_txqs_per_lif;
+	ionic->nxdp_txqs_per_lif = min(dev_ntxqs, num_online_cpus());
 	ionic->nlifs = 1;
 
 	ionic_debugfs_add_sizes(ionic);
@@ -15,6 +15,17 @@
 
 #include "ionic_rx_filter.h"
 
+#ifdef IONIC_XDP
+#include <linux/filter.h>
+#include <net/xdp.h>
+#endif
+#ifdef IONIC_PAGE_POOL
+#include <net/page_pool/helpers.h>
+#endif
+#ifdef IONIC_XSK
+#include <net/xdp_sock_drv.h>
+#endif
+
 #define IONIC_ADMINQ_LENGTH	16	/* must be a power of two */
 #define IONIC_NOTIFYQ_LENGTH	64	/* must be a power of two */
 
@@ -32,6 +43,16 @@
 #define IONIC_RX_COPYBREAK_DEFAULT	256
 #define IONIC_TX_BUDGET_DEFAULT		256
 
+#ifdef IONIC_XDP
+/* Without frags XDP runs on a single page per packet, with headroom
+ * for the xdp_frame and tailroom for an skb_shared_info
+ */
+#define IONIC_XDP_MAX_LINEAR_MTU	(IONIC_PAGE_SIZE -			\
+					 (VLAN_ETH_HLEN +			\
+					  XDP_PACKET_HEADROOM +			\
+					  SKB_DATA_ALIGN(sizeof(struct skb_shared_info))))
+#endif
+
 struct ionic_tx_stats {
 	u64 pkts;
 	u64 bytes;
@@ -39,17 +60,32 @@ struct ionic_tx_stats {
 	u64 csum;
 	u64 tso;
 	u64 tso_bytes;
+	u64 tso_segs;
 	u64 frags;
 	u64 vlan_inserted;
 	u64 clean;
 	u64 linearize;
+	u64 frag_pack;
+	u64 frag_copy_bytes;
+	u64 frag_zc_bytes;
 	u64 crc32_csum;
 #ifdef IONIC_DEBUG_STATS
 	u64 sg_cntr[IONIC_MAX_NUM_SG_CNTR];
+	u64 tso_cycles;
+	u64 clean_cycles;
 #endif
 	u64 dma_map_err;
 	u64 hwstamp_valid;
 	u64 hwstamp_invalid;
+	u64 hwstamp_drop;
+	u64 xdp_frames;
+	u64 xsk_frames;
+	u64 doorbells_saved;
+	u64 bounce_hit;
+	u64 bounce_miss;
+	u64 busy_polls;		/* NAPI polls run by a busy-polling socket */
+	u64 irq_polls;		/* NAPI polls run from the interrupt */
+	u64 dbell_pokes;	/* doorbells re-rung by missed-doorbell recovery */
 };
 
 struct ionic_rx_stats {
@@ -67,6 +103,7 @@ struct ionic_rx_stats {
 	u64 alloc_err;
 	u64 hwstamp_valid;
 	u64 hwstamp_invalid;
+#ifndef IONIC_PAGE_POOL
 	u64 cache_full;
 	u64 cache_empty;
 	u64 cache_busy;
@@ -75,6 +112,24 @@ struct ionic_rx_stats {
 	u64 buf_reused;
 	u64 buf_exhausted;
 	u64 buf_not_reusable;
+#endif
+	u64 xdp_drop;
+	u64 xdp_aborted;
+	u64 xdp_pass;
+	u64 xdp_tx;
+	u64 xdp_redirect;
+	u64 xsk_frames;
+	u64 hdr_split;
+	u64 hdr_only;
+	u64 refills;
+	u64 refill_batch;	/* descriptors posted by the last refill */
+	u64 gro_hw_pkts;	/* aggregates handed to the stack */
+	u64 gro_hw_segs;	/* wire packets folded into them */
+	u64 node_changes;	/* times buffers were re-homed to the NAPI node */
+	u64 busy_polls;		/* NAPI polls run by a busy-polling socket */
+	u64 irq_polls;		/* NAPI polls run from the interrupt */
+	u64 dbell_pokes;	/* doorbells re-rung by missed-doorbell recovery */
+	u64 size_hist[IONIC_RX_SIZE_BUCKETS];
 };
 
 #define IONIC_QCQ_F_INITED		BIT(0)
@@ -84,6 +139,8 @@ struct ionic_rx_stats {
 #define IONIC_QCQ_F_RX_STATS		BIT(4)
 #define IONIC_QCQ_F_NOTIFYQ		BIT(5)
 #define IONIC_QCQ_F_CMB_RINGS		BIT(6)
+#define IONIC_QCQ_F_TX_BOUNCE		BIT(7)
+#define IONIC_QCQ_F_XDP			BIT(8)
 
 #ifdef IONIC_DEBUG_STATS
 struct ionic_napi_stats {
@@ -107,12 +164,18 @@ struct ionic_qcq {
 	u32 cmb_q_size;
 	u32 cmb_pgid;
 	u32 cmb_order;
+	/* tx: premapped slots that small heads are copied into */
+	struct page *tx_bounce_page;
+	void *tx_bounce_base;
+	dma_addr_t tx_bounce_dma;
+	u32 tx_bounce_size;
+	u32 tx_bounce_order;
+	u32 tx_bounce_slots;
 	bool armed;
 	struct dim dim;
 	struct ionic_queue q;
 	struct ionic_cq cq;
 	struct ionic_intr_info intr;
-	struct timer_list napi_deadline;
 	struct napi_struct napi;
 #ifdef IONIC_DEBUG_STATS
 	struct ionic_napi_stats napi_stats;
@@ -132,6 +195,7 @@ enum ionic_deferred_work_type {
 	IONIC_DW_TYPE_RX_MODE,
 	IONIC_DW_TYPE_LINK_STATUS,
 	IONIC_DW_TYPE_LIF_RESET,
+	IONIC_DW_TYPE_INTR_MODE,
 };
 
 struct ionic_deferred_work {
@@ -163,6 +227,7 @@ struct ionic_lif_sw_stats {
 	u64 rx_csum_error;
 	u64 tx_hwstamp_valid;
 	u64 tx_hwstamp_invalid;
+	u64 tx_hwstamp_drop;
 	u64 rx_hwstamp_valid;
 	u64 rx_hwstamp_invalid;
 	u64 hw_tx_dropped;
@@ -187,6 +252,9 @@ enum ionic_lif_state_flags {
 	IONIC_LIF_F_RX_DIM_INTR,
 	IONIC_LIF_F_CMB_TX_RINGS,
 	IONIC_LIF_F_CMB_RX_RINGS,
+	IONIC_LIF_F_RX_HDR_SPLIT,
+	IONIC_LIF_F_TX_BOUNCE,
+	IONIC_LIF_F_AUTO_SPLIT_INTR,
 
 	/* leave this as last */
 	IONIC_LIF_F_STATE_SIZE
@@ -211,6 +279,24 @@ struct ionic_qtype_info {
 	u16 sg_desc_stride;
 };
 
+/* Per-queue coalescing set with ethtool --per-queue, which overrides
+ * the lif-wide values until the next lif-wide ethtool -C
+ */
+struct ionic_queue_coal {
+	u32 usecs;			/* what the user asked for */
+	u32 hw;				/* what the hw is using */
+	bool adaptive;
+	bool override;
+};
+
+/* Queue pair packet rates sampled for the automatic interrupt mode */
+struct ionic_qpair_rate {
+	u64 tx_pkts;
+	u64 rx_pkts;
+	u64 tx_pps;
+	u64 rx_pps;
+};
+
 struct ionic_phc;
 
 #define IONIC_LIF_NAME_MAX_SZ		32
@@ -224,10 +310,20 @@ struct ionic_lif {
 
 	struct ionic_qcq **txqcqs;
 	struct ionic_tx_stats *txqstats;
+	cpumask_t *xps_masks;		/* XPS map last set by the driver */
 	struct ionic_qcq **rxqcqs;
 	struct ionic_rx_stats *rxqstats;
-	struct ionic_qcq *hwstamp_txq;
+	struct ionic_qcq *hwstamp_txqs[IONIC_MAX_HWSTAMP_TXQS];
+	unsigned int nhwstamp_txqs;
 	struct ionic_qcq *hwstamp_rxq;
+#ifdef IONIC_XDP
+	struct bpf_prog *xdp_prog;
+	struct ionic_qcq **xdp_txqcqs;	/* XDP-only txqs, polled from rx NAPI */
+	unsigned int nxdp_txqs;
+#endif
+#ifdef IONIC_XSK
+	struct xsk_buff_pool **xsk_pools;	/* AF_XDP pools by queue index */
+#endif
 
 	struct ionic_qcq *adminqcq;
 	struct ionic_qcq *notifyqcq;
@@ -237,6 +333,8 @@ struct ionic_lif {
 	unsigned int kern_pid;
 
 	struct work_struct tx_timeout_work;
+	struct delayed_work dbell_sweep;	/* missed-doorbell recovery */
+	u64 dbell_sweep_kicks;
 	struct ionic_deferred deferred;
 
 	u64 last_eid;
@@ -280,6 +378,15 @@ struct ionic_lif {
 	u32 rx_coalesce_hw;		/* what the hw is using */
 	u32 tx_coalesce_usecs;		/* what the user asked for */
 	u32 tx_coalesce_hw;		/* what the hw is using */
+	struct ionic_queue_coal *txq_coal;	/* ethtool --per-queue */
+	struct ionic_queue_coal *rxq_coal;
+	u32 dim_tx_hw[IONIC_DIM_NUM_PROFILES];	/* DIM profiles, hw units */
+	u32 dim_rx_hw[IONIC_DIM_NUM_PROFILES];
+
+	struct ionic_qpair_rate *qpair_rates;	/* auto-split-intr */
+	unsigned long intr_auto_jiffies;	/* last sample, 0 for none */
+	bool intr_auto_split;			/* the mode it wants */
+	u64 intr_auto_switches;
 
 	struct ionic_phc *phc;
 
@@ -322,6 +429,7 @@ struct ionic_queue_params {
 	bool intr_split;
 	bool cmb_tx;
 	bool cmb_rx;
+	bool hdr_split;
 };
 
 static inline void ionic_init_queue_params(struct ionic_lif *lif,
@@ -334,6 +442,7 @@ static inline void ionic_init_queue_params(struct ionic_lif *lif,
 	qparam->intr_split = test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state);
 	qparam->cmb_tx = test_bit(IONIC_LIF_F_CMB_TX_RINGS, lif->state);
 	qparam->cmb_rx = test_bit(IONIC_LIF_F_CMB_RX_RINGS, lif->state);
+	qparam->hdr_split = test_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state);
 }
 
 static inline void ionic_set_queue_params(struct ionic_lif *lif,
@@ -358,6 +467,11 @@ static inline void ionic_set_queue_params(struct ionic_lif *lif,
 		set_bit(IONIC_LIF_F_CMB_RX_RINGS, lif->state);
 	else
 		clear_bit(IONIC_LIF_F_CMB_RX_RINGS, lif->state);
+
+	if (qparam->hdr_split)
+		set_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state);
+	else
+		clear_bit(IONIC_LIF_F_RX_HDR_SPLIT, lif->state);
 }
 
 static inline u32 ionic_coal_usec_to_hw(struct ionic *ionic, u32 usecs)
@@ -433,7 +547,7 @@ static inline void ionic_lif_alloc_phc(struct ionic_lif *lif) {}
 static inline void ionic_lif_free_phc(struct ionic_lif *lif) {}
 #endif
 
-int ionic_lif_create_hwstamp_txq(struct ionic_lif *lif);
+int ionic_lif_create_hwstamp_txqs(struct ionic_lif *lif);
 int ionic_lif_create_hwstamp_rxq(struct ionic_lif *lif);
 int ionic_lif_config_hwstamp_rxq_all(struct ionic_lif *lif, bool rx_all);
 int ionic_lif_set_hwstamp_txmode(struct ionic_lif *lif, u16 txstamp_mode);
@@ -441,6 +555,9 @@ int ionic_lif_set_hwstamp_rxfilt(struct ionic_lif *lif, u64 pkt_class);
 
 int ionic_lif_rss_config(struct ionic_lif *lif, u16 types,
 			 const u8 *key, const u32 *indir);
+int ionic_lif_set_threaded(struct ionic_lif *lif, bool threaded);
+void ionic_lif_qcq_coal_init(struct ionic_lif *lif, struct ionic_qcq *qcq);
+void ionic_lif_intr_mode_check(struct ionic_lif *lif);
 
 int ionic_intr_alloc(struct ionic *ionic, struct ionic_intr_info *intr);
 void ionic_intr_free(struct ionic *ionic, int index);
@@ -27,14 +27,22 @@ unsigned int rx_copybreak = IONIC_RX_COPYBREAK_DEFAULT;
 module_param(rx_copybreak, uint, 0600);
 MODULE_PARM_DESC(rx_copybreak, "Maximum size of packet that is copied to a bounce buffer on RX");
 
+bool rx_copybreak_adaptive;
+module_param(rx_copybreak_adaptive, bool, 0600);
+MODULE_PARM_DESC(rx_copybreak_adaptive, "Tune each Rx queue's copybreak up to rx_copybreak from its packet sizes (default 0)");
+
 unsigned int rx_fill_threshold = IONIC_RX_FILL_THRESHOLD;
 module_param(rx_fill_threshold, uint, 0600);
-MODULE_PARM_DESC(rx_fill_threshold, "Minimum number of buffers to fill");
+MODULE_PARM_DESC(rx_fill_threshold, "Minimum number of buffers to fill, raised per queue with its completion rate");
 
 unsigned int tx_budget = IONIC_TX_BUDGET_DEFAULT;
 module_param(tx_budget, uint, 0600);
 MODULE_PARM_DESC(tx_budget, "Number of tx completions to process per NAPI poll");
 
+unsigned int tx_dbell_batch;
+module_param(tx_dbell_batch, uint, 0600);
+MODULE_PARM_DESC(tx_dbell_batch, "Number of Tx descriptors a doorbell may be held back for, taken when the queues are next started (default 0, max 64)");
+
 unsigned int devcmd_timeout = DEVCMD_TOUT_DEF;
 module_param(devcmd_timeout, uint, 0600);
 MODULE_PARM_DESC(devcmd_timeout, "Devcmd timeout in seconds (default 30 secs)");
@@ -129,7 +129,7 @@ static int ionic_lif_hwstamp_set_ts_config(struct ionic_lif *lif,
 		__func__, config->rx_filter, rx_filt, rx_all);
 
 	if (tx_mode) {
-		err = ionic_lif_create_hwstamp_txq(lif);
+		err = ionic_lif_create_hwstamp_txqs(lif);
 		if (err)
 			goto err_queues;
 	}
@@ -238,7 +238,7 @@ void ionic_lif_hwstamp_recreate_queues(struct ionic_lif *lif)
 	mutex_lock(&lif->phc->config_lock);
 
 	if (lif->phc->ts_config_tx_mode) {
-		err = ionic_lif_create_hwstamp_txq(lif);
+		err = ionic_lif_create_hwstamp_txqs(lif);
 		if (err)
 			netdev_info(lif->netdev, "hwstamp recreate txq failed: %d\n", err);
 	}
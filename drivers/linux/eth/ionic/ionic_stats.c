@@ -16,6 +16,7 @@ static const struct ionic_stat_desc ionic_lif_stats_desc[] = {
 	IONIC_LIF_STAT_DESC(tx_tso_bytes),
 	IONIC_LIF_STAT_DESC(tx_csum_none),
 	IONIC_LIF_STAT_DESC(tx_csum),
+	IONIC_LIF_STAT_DESC(tx_hwstamp_drop),
 	IONIC_LIF_STAT_DESC(rx_csum_none),
 	IONIC_LIF_STAT_DESC(rx_csum_complete),
 	IONIC_LIF_STAT_DESC(rx_csum_error),
@@ -159,15 +160,30 @@ static const struct ionic_stat_desc ionic_tx_stats_desc[] = {
 	IONIC_TX_STAT_DESC(clean),
 	IONIC_TX_STAT_DESC(dma_map_err),
 	IONIC_TX_STAT_DESC(linearize),
+	IONIC_TX_STAT_DESC(frag_pack),
+	IONIC_TX_STAT_DESC(frag_copy_bytes),
+	IONIC_TX_STAT_DESC(frag_zc_bytes),
 	IONIC_TX_STAT_DESC(tso),
 	IONIC_TX_STAT_DESC(tso_bytes),
+	IONIC_TX_STAT_DESC(tso_segs),
 	IONIC_TX_STAT_DESC(hwstamp_valid),
 	IONIC_TX_STAT_DESC(hwstamp_invalid),
+	IONIC_TX_STAT_DESC(hwstamp_drop),
+	IONIC_TX_STAT_DESC(xdp_frames),
+	IONIC_TX_STAT_DESC(xsk_frames),
+	IONIC_TX_STAT_DESC(doorbells_saved),
+	IONIC_TX_STAT_DESC(bounce_hit),
+	IONIC_TX_STAT_DESC(bounce_miss),
+	IONIC_TX_STAT_DESC(busy_polls),
+	IONIC_TX_STAT_DESC(irq_polls),
+	IONIC_TX_STAT_DESC(dbell_pokes),
 #ifdef IONIC_DEBUG_STATS
 	IONIC_TX_STAT_DESC(vlan_inserted),
 	IONIC_TX_STAT_DESC(frags),
 	IONIC_TX_STAT_DESC(csum),
 	IONIC_TX_STAT_DESC(csum_none),
+	IONIC_TX_STAT_DESC(tso_cycles),
+	IONIC_TX_STAT_DESC(clean_cycles),
 #endif
 };
 
@@ -185,6 +201,7 @@ static const struct ionic_stat_desc ionic_rx_stats_desc[] = {
 	IONIC_RX_STAT_DESC(hwstamp_valid),
 	IONIC_RX_STAT_DESC(hwstamp_invalid),
 	IONIC_RX_STAT_DESC(dropped),
+#ifndef IONIC_PAGE_POOL
 	IONIC_RX_STAT_DESC(cache_full),
 	IONIC_RX_STAT_DESC(cache_empty),
 	IONIC_RX_STAT_DESC(cache_busy),
@@ -193,8 +210,41 @@ static const struct ionic_stat_desc ionic_rx_stats_desc[] = {
 	IONIC_RX_STAT_DESC(buf_exhausted),
 	IONIC_RX_STAT_DESC(buf_not_reusable),
 	IONIC_RX_STAT_DESC(buf_reused),
+#endif
+	IONIC_RX_STAT_DESC(xdp_drop),
+	IONIC_RX_STAT_DESC(xdp_aborted),
+	IONIC_RX_STAT_DESC(xdp_pass),
+	IONIC_RX_STAT_DESC(xdp_tx),
+	IONIC_RX_STAT_DESC(xdp_redirect),
+	IONIC_RX_STAT_DESC(xsk_frames),
+	IONIC_RX_STAT_DESC(hdr_split),
+	IONIC_RX_STAT_DESC(hdr_only),
+	IONIC_RX_STAT_DESC(refills),
+	IONIC_RX_STAT_DESC(refill_batch),
+	IONIC_RX_STAT_DESC(gro_hw_pkts),
+	IONIC_RX_STAT_DESC(gro_hw_segs),
+	IONIC_RX_STAT_DESC(node_changes),
+	IONIC_RX_STAT_DESC(busy_polls),
+	IONIC_RX_STAT_DESC(irq_polls),
+	IONIC_RX_STAT_DESC(dbell_pokes),
 };
 
+#ifdef IONIC_PAGE_POOL_STATS
+static const struct ionic_stat_desc ionic_rx_pp_stats_desc[] = {
+	IONIC_PP_STAT_DESC(alloc_fast, alloc_stats.fast),
+	IONIC_PP_STAT_DESC(alloc_slow, alloc_stats.slow),
+	IONIC_PP_STAT_DESC(alloc_slow_high_order, alloc_stats.slow_high_order),
+	IONIC_PP_STAT_DESC(alloc_empty, alloc_stats.empty),
+	IONIC_PP_STAT_DESC(alloc_refill, alloc_stats.refill),
+	IONIC_PP_STAT_DESC(alloc_waive, alloc_stats.waive),
+	IONIC_PP_STAT_DESC(recycle_cached, recycle_stats.cached),
+	IONIC_PP_STAT_DESC(recycle_cache_full, recycle_stats.cache_full),
+	IONIC_PP_STAT_DESC(recycle_ring, recycle_stats.ring),
+	IONIC_PP_STAT_DESC(recycle_ring_full, recycle_stats.ring_full),
+	IONIC_PP_STAT_DESC(recycle_released_ref, recycle_stats.released_refcnt),
+};
+#endif
+
 #ifdef IONIC_DEBUG_STATS
 static const struct ionic_stat_desc ionic_txq_stats_desc[] = {
 	IONIC_TX_Q_STAT_DESC(stop),
@@ -230,6 +280,9 @@ static const struct ionic_stat_desc ionic_dbg_napi_stats_desc[] = {
 #define IONIC_NUM_MGMT_PORT_STATS ARRAY_SIZE(ionic_mgmt_port_stats_desc)
 #define IONIC_NUM_TX_STATS ARRAY_SIZE(ionic_tx_stats_desc)
 #define IONIC_NUM_RX_STATS ARRAY_SIZE(ionic_rx_stats_desc)
+#ifdef IONIC_PAGE_POOL_STATS
+#define IONIC_NUM_RX_PP_STATS ARRAY_SIZE(ionic_rx_pp_stats_desc)
+#endif
 
 #define MAX_Q(lif)   ((lif)->netdev->real_num_tx_queues)
 
@@ -246,6 +299,7 @@ static void ionic_add_lif_txq_stats(struct ionic_lif *lif, int q_num,
 	stats->tx_csum += txstats->csum;
 	stats->tx_hwstamp_valid += txstats->hwstamp_valid;
 	stats->tx_hwstamp_invalid += txstats->hwstamp_invalid;
+	stats->tx_hwstamp_drop += txstats->hwstamp_drop;
 }
 
 static void ionic_add_lif_rxq_stats(struct ionic_lif *lif, int q_num,
@@ -275,8 +329,15 @@ static void ionic_get_lif_stats(struct ionic_lif *lif,
 		ionic_add_lif_rxq_stats(lif, q_num, stats);
 	}
 
-	if (lif->hwstamp_txq)
-		ionic_add_lif_txq_stats(lif, lif->hwstamp_txq->q.index, stats);
+	for (q_num = 0; q_num < lif->nhwstamp_txqs; q_num++)
+		ionic_add_lif_txq_stats(lif, lif->hwstamp_txqs[q_num]->q.index,
+					stats);
+
+#ifdef IONIC_XDP
+	for (q_num = 0; q_num < lif->nxdp_txqs; q_num++)
+		ionic_add_lif_txq_stats(lif, lif->xdp_txqcqs[q_num]->q.index,
+					stats);
+#endif
 
 	if (lif->hwstamp_rxq)
 		ionic_add_lif_rxq_stats(lif, lif->hwstamp_rxq->q.index, stats);
@@ -300,14 +361,19 @@ static u64 ionic_sw_stats_get_count(struct ionic_lif *lif)
 	else
 		total += IONIC_NUM_PORT_STATS;
 
-	if (lif->hwstamp_txq)
-		tx_queues += 1;
+	tx_queues += lif->nhwstamp_txqs;
 
 	if (lif->hwstamp_rxq)
 		rx_queues += 1;
 
 	total += tx_queues * IONIC_NUM_TX_STATS;
 	total += rx_queues * IONIC_NUM_RX_STATS;
+#ifdef IONIC_XDP
+	total += lif->nxdp_txqs * IONIC_NUM_TX_STATS;
+#endif
+#ifdef IONIC_PAGE_POOL_STATS
+	total += rx_queues * IONIC_NUM_RX_PP_STATS;
+#endif
 
 #ifdef IONIC_DEBUG_STATS
 	if (test_bit(IONIC_LIF_F_UP, lif->state) &&
@@ -372,6 +438,11 @@ static void ionic_sw_stats_get_rx_strings(struct ionic_lif *lif, u8 **buf,
 	for (i = 0; i < IONIC_NUM_RX_STATS; i++)
 		ethtool_sprintf(buf, "rx_%d_%s", q_num,
 				ionic_rx_stats_desc[i].name);
+#ifdef IONIC_PAGE_POOL_STATS
+	for (i = 0; i < IONIC_NUM_RX_PP_STATS; i++)
+		ethtool_sprintf(buf, "rx_%d_%s", q_num,
+				ionic_rx_pp_stats_desc[i].name);
+#endif
 
 #ifdef IONIC_DEBUG_STATS
 	if (!test_bit(IONIC_LIF_F_UP, lif->state) ||
@@ -410,8 +481,17 @@ static void ionic_sw_stats_get_strings(struct ionic_lif *lif, u8 **buf)
 	for (q_num = 0; q_num < MAX_Q(lif); q_num++)
 		ionic_sw_stats_get_tx_strings(lif, buf, q_num);
 
-	if (lif->hwstamp_txq)
-		ionic_sw_stats_get_tx_strings(lif, buf, lif->hwstamp_txq->q.index);
+	for (q_num = 0; q_num < lif->nhwstamp_txqs; q_num++)
+		ionic_sw_stats_get_tx_strings(lif, buf,
+					      lif->hwstamp_txqs[q_num]->q.index);
+
+#ifdef IONIC_XDP
+	/* xdp txqs only report the basic tx counters */
+	for (q_num = 0; q_num < lif->nxdp_txqs; q_num++)
+		for (i = 0; i < IONIC_NUM_TX_STATS; i++)
+			ethtool_sprintf(buf, "xdp_tx_%d_%s", q_num,
+					ionic_tx_stats_desc[i].name);
+#endif
 
 	for (q_num = 0; q_num < MAX_Q(lif); q_num++)
 		ionic_sw_stats_get_rx_strings(lif, buf, q_num);
@@ -421,12 +501,9 @@ static void ionic_sw_stats_get_strings(struct ionic_lif *lif, u8 **buf)
 }
 
 static void ionic_sw_stats_get_txq_values(struct ionic_lif *lif, u64 **buf,
-					  int q_num)
+					  int q_num, struct ionic_qcq *txqcq)
 {
 	struct ionic_tx_stats *txstats;
-#ifdef IONIC_DEBUG_STATS
-	struct ionic_qcq *txqcq;
-#endif
 	int i;
 
 	txstats = &lif->txqstats[q_num];
@@ -441,7 +518,6 @@ static void ionic_sw_stats_get_txq_values(struct ionic_lif *lif, u64 **buf,
 	    !test_bit(IONIC_LIF_F_SW_DEBUG_STATS, lif->state))
 		return;
 
-	txqcq = lif->txqcqs[q_num];
 	for (i = 0; i < IONIC_NUM_TX_Q_STATS; i++) {
 		**buf = IONIC_READ_STAT64(&txqcq->q,
 					  &ionic_txq_stats_desc[i]);
@@ -473,10 +549,27 @@ static void ionic_sw_stats_get_txq_values(struct ionic_lif *lif, u64 **buf,
 #endif
 }
 
+#ifdef IONIC_PAGE_POOL_STATS
+static struct page_pool *ionic_rx_page_pool(struct ionic_lif *lif, int q_num)
+{
+	if (lif->hwstamp_rxq && q_num == lif->hwstamp_rxq->q.index)
+		return lif->hwstamp_rxq->q.page_pool;
+
+	if (lif->rxqcqs && lif->rxqcqs[q_num])
+		return lif->rxqcqs[q_num]->q.page_pool;
+
+	return NULL;
+}
+#endif
+
 static void ionic_sw_stats_get_rxq_values(struct ionic_lif *lif, u64 **buf,
 					  int q_num)
 {
 	struct ionic_rx_stats *rxstats;
+#ifdef IONIC_PAGE_POOL_STATS
+	struct page_pool_stats pp_stats = {};
+	struct page_pool *pool;
+#endif
 #ifdef IONIC_DEBUG_STATS
 	struct ionic_qcq *rxqcq;
 #endif
@@ -489,6 +582,18 @@ static void ionic_sw_stats_get_rxq_values(struct ionic_lif *lif, u64 **buf,
 		(*buf)++;
 	}
 
+#ifdef IONIC_PAGE_POOL_STATS
+	/* the pool goes away with the queue, report zeros until it's back */
+	pool = ionic_rx_page_pool(lif, q_num);
+	if (pool)
+		page_pool_get_stats(pool, &pp_stats);
+
+	for (i = 0; i < IONIC_NUM_RX_PP_STATS; i++) {
+		**buf = IONIC_READ_STAT64(&pp_stats, &ionic_rx_pp_stats_desc[i]);
+		(*buf)++;
+	}
+#endif
+
 #ifdef IONIC_DEBUG_STATS
 	if (!test_bit(IONIC_LIF_F_UP, lif->state) ||
 	    !test_bit(IONIC_LIF_F_SW_DEBUG_STATS, lif->state))
@@ -548,10 +653,26 @@ static void ionic_sw_stats_get_values(struct ionic_lif *lif, u64 **buf)
 	}
 
 	for (q_num = 0; q_num < MAX_Q(lif); q_num++)
-		ionic_sw_stats_get_txq_values(lif, buf, q_num);
-
-	if (lif->hwstamp_txq)
-		ionic_sw_stats_get_txq_values(lif, buf, lif->hwstamp_txq->q.index);
+		ionic_sw_stats_get_txq_values(lif, buf, q_num,
+					      lif->txqcqs[q_num]);
+
+	for (q_num = 0; q_num < lif->nhwstamp_txqs; q_num++)
+		ionic_sw_stats_get_txq_values(lif, buf,
+					      lif->hwstamp_txqs[q_num]->q.index,
+					      lif->hwstamp_txqs[q_num]);
+
+#ifdef IONIC_XDP
+	for (q_num = 0; q_num < lif->nxdp_txqs; q_num++) {
+		struct ionic_tx_stats *txstats;
+
+		txstats = &lif->txqstats[lif->xdp_txqcqs[q_num]->q.index];
+		for (i = 0; i < IONIC_NUM_TX_STATS; i++) {
+			**buf = IONIC_READ_STAT64(txstats,
+						  &ionic_tx_stats_desc[i]);
+			(*buf)++;
+		}
+	}
+#endif
 
 	for (q_num = 0; q_num < MAX_Q(lif); q_num++)
 		ionic_sw_stats_get_rxq_values(lif, buf, q_num);
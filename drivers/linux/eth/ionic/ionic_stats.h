@@ -26,6 +26,13 @@
 #define IONIC_RX_STAT_DESC(stat_name) \
 	IONIC_STAT_DESC(struct ionic_rx_stats, stat_name)
 
+#ifdef IONIC_PAGE_POOL_STATS
+#define IONIC_PP_STAT_DESC(stat_name, field) { \
+	.name = "pp_" #stat_name, \
+	.offset = IONIC_STAT_TO_OFFSET(struct page_pool_stats, field) \
+}
+#endif
+
 #ifdef IONIC_DEBUG_STATS
 #define IONIC_TX_Q_STAT_DESC(stat_name) \
 	IONIC_STAT_DESC(struct ionic_queue, stat_name)
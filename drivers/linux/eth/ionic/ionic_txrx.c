@@ -11,12 +11,21 @@
 #include "ionic_lif.h"
 #include "ionic_txrx.h"
 
+#ifdef IONIC_XDP
+#include <linux/bpf_trace.h>
+#endif
+
 static inline void ionic_txq_post(struct ionic_queue *q, bool ring_dbell,
 				  ionic_desc_cb cb_func, void *cb_arg)
 {
 	DEBUG_STATS_TXQ_POST(q, ring_dbell);
 
 	ionic_q_post(q, ring_dbell, cb_func, cb_arg);
+
+	if (ring_dbell) {
+		q->dbell_idx = q->head_idx;
+		q->dbell_deferred = false;
+	}
 }
 
 static inline void ionic_rxq_post(struct ionic_queue *q, bool ring_dbell,
@@ -47,11 +56,14 @@ bool ionic_txq_poke_doorbell(struct ionic_queue *q)
 	then = q->dbell_jiffies;
 	dif = now - then;
 
-	if (dif > q->dbell_deadline) {
+	if (dif > q->dbell_deadline || q->dbell_deferred) {
 		ionic_dbell_ring(q->lif->kern_dbpage, q->hw_type,
 				 q->dbval | q->head_idx);
 
 		q->dbell_jiffies = now;
+		q->dbell_idx = q->head_idx;
+		q->dbell_deferred = false;
+		q_to_tx_stats(q)->dbell_pokes++;
 	}
 
 	HARD_TX_UNLOCK(netdev, netdev_txq);
@@ -59,6 +71,36 @@ bool ionic_txq_poke_doorbell(struct ionic_queue *q)
 	return true;
 }
 
+/* Ring the doorbell that Tx batching held back, from the napi poll
+ * after the completions have been cleaned.
+ */
+static void ionic_txq_dbell_flush(struct ionic_queue *q)
+{
+	struct netdev_queue *netdev_txq;
+	struct net_device *netdev;
+
+	/* pairs with the barrier in ionic_txq_dbell_defer() */
+	smp_mb();
+	if (!READ_ONCE(q->dbell_deferred))
+		return;
+
+	netdev = q->lif->netdev;
+	netdev_txq = netdev_get_tx_queue(netdev, q->index);
+
+	HARD_TX_LOCK(netdev, netdev_txq, smp_processor_id());
+
+	if (q->dbell_deferred) {
+		ionic_dbell_ring(q->lif->kern_dbpage, q->hw_type,
+				 q->dbval | q->head_idx);
+
+		q->dbell_jiffies = jiffies;
+		q->dbell_idx = q->head_idx;
+		q->dbell_deferred = false;
+	}
+
+	HARD_TX_UNLOCK(netdev, netdev_txq);
+}
+
 bool ionic_rxq_poke_doorbell(struct ionic_queue *q)
 {
 	unsigned long now, then, dif;
@@ -77,6 +119,7 @@ bool ionic_rxq_poke_doorbell(struct ionic_queue *q)
 				 q->dbval | q->head_idx);
 
 		q->dbell_jiffies = now;
+		q_to_rx_stats(q)->dbell_pokes++;
 
 		dif = 2 * q->dbell_deadline;
 		if (dif > IONIC_RX_MAX_DOORBELL_DEADLINE)
@@ -93,6 +136,52 @@ static inline struct netdev_queue *q_to_ndq(struct ionic_queue *q)
 	return netdev_get_tx_queue(q->lif->netdev, q->index);
 }
 
+/* Whether the doorbell for the descriptor about to be posted can wait.
+ * It can if the stack has more for us, or if batching is on, fewer
+ * than dbell_batch descriptors would be waiting, the last doorbell was
+ * rung this jiffy, and earlier descriptors are still in flight, so the
+ * completion poll is sure to come round and ring it.
+ */
+static bool ionic_txq_dbell_defer(struct ionic_queue *q)
+{
+	unsigned int batch, pending;
+
+	/* the hwstamp txqs have no netdev queue of their own, and the XDP
+	 * txqs none at all, so their doorbells are never held back
+	 */
+	if (unlikely(q->features & IONIC_TXQ_F_HWSTAMP) ||
+	    q_to_qcq(q)->flags & IONIC_QCQ_F_XDP)
+		return false;
+
+	if (netif_xmit_stopped(q_to_ndq(q)))
+		return false;
+
+#ifdef HAVE_SKB_XMIT_MORE
+	if (netdev_xmit_more())
+		return true;
+#endif
+
+	batch = READ_ONCE(q->dbell_batch);
+	if (batch <= 1)
+		return false;
+
+	pending = (q->head_idx + 1 - q->dbell_idx) & (q->num_descs - 1);
+	if (pending >= batch || time_after(jiffies, q->dbell_jiffies))
+		return false;
+
+	WRITE_ONCE(q->dbell_deferred, true);
+	/* pairs with the barrier in ionic_txq_dbell_flush() */
+	smp_mb();
+	if (READ_ONCE(q->tail_idx) == q->dbell_idx) {
+		q->dbell_deferred = false;
+		return false;
+	}
+
+	q_to_tx_stats(q)->doorbells_saved++;
+
+	return true;
+}
+
 static inline void *ionic_rx_buf_va(struct ionic_buf_info *buf_info)
 {
 	return page_address(buf_info->page) + buf_info->page_offset;
@@ -105,16 +194,129 @@ static inline dma_addr_t ionic_rx_buf_pa(struct ionic_buf_info *buf_info)
 
 static inline unsigned int ionic_rx_buf_size(struct ionic_buf_info *buf_info)
 {
+#ifdef IONIC_PAGE_POOL
+	return buf_info->len;
+#else
 	return IONIC_PAGE_SIZE - buf_info->page_offset;
+#endif
+}
+
+static inline unsigned int ionic_rx_headroom(struct ionic_queue *q)
+{
+#ifdef IONIC_XDP
+	return q->xdp_prog ? XDP_PACKET_HEADROOM : 0;
+#else
+	return 0;
+#endif
+}
+
+/* XDP keeps room at the end of the first buffer for the skb_shared_info
+ * that holds its frags, and that build_skb() later reuses
+ */
+static inline unsigned int ionic_rx_tailroom(struct ionic_queue *q)
+{
+	return ionic_rx_headroom(q) ?
+	       SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) : 0;
+}
+
+/* Size of a fresh rx buffer that wants to hold len bytes.  Buffers are
+ * carved from pages in IONIC_PAGE_SPLIT_SZ units, but XDP gets a whole
+ * page per buffer for its headroom and the xdp_frame.
+ */
+static inline unsigned int ionic_rx_alloc_size(struct ionic_queue *q,
+					       unsigned int len)
+{
+	if (ionic_rx_headroom(q))
+		return IONIC_PAGE_SIZE;
+
+	return min_t(unsigned int, ALIGN(len, IONIC_PAGE_SPLIT_SZ),
+		     IONIC_PAGE_SIZE);
+}
+
+#ifdef IONIC_PAGE_POOL
+static void ionic_rx_buf_complete(struct ionic_queue *q,
+				  struct ionic_buf_info *buf_info, u32 used)
+{
+	/* the fragment now belongs to the skb, which hands it back to
+	 * the page_pool when it is freed
+	 */
+	buf_info->page = NULL;
+}
+
+static inline int ionic_rx_page_alloc(struct ionic_queue *q,
+				      struct ionic_buf_info *buf_info,
+				      unsigned int size)
+{
+	struct net_device *netdev = q->lif->netdev;
+	struct ionic_rx_stats *stats;
+	unsigned int offset;
+	struct page *page;
+
+	stats = q_to_rx_stats(q);
+
+	if (unlikely(!buf_info)) {
+		net_err_ratelimited("%s: %s invalid buf_info in alloc\n",
+				    netdev->name, q->name);
+		return -EINVAL;
+	}
+
+	page = page_pool_dev_alloc_frag(q->page_pool, &offset, size);
+	if (unlikely(!page)) {
+		net_err_ratelimited("%s: %s page alloc failed\n",
+				    netdev->name, q->name);
+		stats->alloc_err++;
+		return -ENOMEM;
+	}
+
+	/* the pool keeps the page mapped for as long as it owns it */
+	buf_info->page = page;
+	buf_info->page_offset = offset;
+	buf_info->dma_addr = page_pool_get_dma_addr(page);
+	buf_info->len = size;
+
+	return 0;
+}
+
+static inline void ionic_rx_page_free(struct ionic_queue *q,
+				      struct ionic_buf_info *buf_info)
+{
+	struct net_device *netdev = q->lif->netdev;
+
+	if (unlikely(!buf_info)) {
+		net_err_ratelimited("%s: %s invalid buf_info in free\n",
+				    netdev->name, q->name);
+		return;
+	}
+
+	if (!buf_info->page)
+		return;
+
+	page_pool_put_full_page(q->page_pool, buf_info->page, false);
+	buf_info->page = NULL;
+}
+#else
+static void ionic_rx_buf_unmap(struct ionic_queue *q,
+			       struct ionic_buf_info *buf_info)
+{
+#ifndef HAVE_STRUCT_DMA_ATTRS
+	dma_unmap_page_attrs(q->dev, buf_info->dma_addr, IONIC_PAGE_SIZE,
+			     DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+#else
+	dma_unmap_page(q->dev, buf_info->dma_addr, IONIC_PAGE_SIZE, DMA_FROM_DEVICE);
+#endif
 }
 
 static bool ionic_rx_cache_put(struct ionic_queue *q,
 			       struct ionic_buf_info *buf_info)
 {
-	struct ionic_page_cache *cache = &q->page_cache;
+	struct ionic_page_cache *cache = q->page_cache;
 	struct ionic_rx_stats *stats = q_to_rx_stats(q);
 	u32 tail_next;
 
+	/* not worth keeping a page that is remote to the NAPI context */
+	if (page_to_nid(buf_info->page) != READ_ONCE(q->node))
+		return false;
+
 	tail_next = (cache->tail + 1) & (IONIC_PAGE_CACHE_SIZE - 1);
 	if (tail_next == cache->head) {
 		stats->cache_full++;
@@ -133,7 +335,7 @@ static bool ionic_rx_cache_put(struct ionic_queue *q,
 static bool ionic_rx_cache_get(struct ionic_queue *q,
 			       struct ionic_buf_info *buf_info)
 {
-	struct ionic_page_cache *cache = &q->page_cache;
+	struct ionic_page_cache *cache = q->page_cache;
 	struct ionic_rx_stats *stats = q_to_rx_stats(q);
 
 	if (unlikely(cache->head == cache->tail)) {
@@ -146,6 +348,18 @@ static bool ionic_rx_cache_get(struct ionic_queue *q,
 		return false;
 	}
 
+	/* left over from before the queue was re-homed, let it go */
+	if (unlikely(page_to_nid(cache->ring[cache->head].page) !=
+		     READ_ONCE(q->node))) {
+		struct ionic_buf_info *stale = &cache->ring[cache->head];
+
+		/* the CPU won't read it again, nothing to sync */
+		ionic_rx_buf_unmap(q, stale);
+		put_page(stale->page);
+		cache->head = (cache->head + 1) & (IONIC_PAGE_CACHE_SIZE - 1);
+		return false;
+	}
+
 	*buf_info = cache->ring[cache->head];
 	cache->head = (cache->head + 1) & (IONIC_PAGE_CACHE_SIZE - 1);
 	stats->cache_get++;
@@ -159,7 +373,7 @@ static bool ionic_rx_cache_get(struct ionic_queue *q,
 
 static void ionic_rx_cache_drain(struct ionic_queue *q)
 {
-	struct ionic_page_cache *cache = &q->page_cache;
+	struct ionic_page_cache *cache = q->page_cache;
 	struct ionic_rx_stats *stats = q_to_rx_stats(q);
 	struct ionic_buf_info *buf_info;
 
@@ -171,6 +385,14 @@ static void ionic_rx_cache_drain(struct ionic_queue *q)
 		cache->head = (cache->head + 1) & (IONIC_PAGE_CACHE_SIZE - 1);
 	}
 
+	/* never posted to the device, so there is nothing to sync */
+	while (cache->bulk_avail) {
+		buf_info = &cache->bulk[--cache->bulk_avail];
+		ionic_rx_buf_unmap(q, buf_info);
+		__free_pages(buf_info->page, IONIC_PAGE_ORDER);
+		buf_info->page = NULL;
+	}
+
 	cache->head = 0;
 	cache->tail = 0;
 	stats->cache_empty = 0;
@@ -180,6 +402,58 @@ static void ionic_rx_cache_drain(struct ionic_queue *q)
 	stats->cache_full = 0;
 }
 
+#ifdef HAVE_ALLOC_PAGES_BULK
+/* When the recycle cache comes up dry, pull a batch of pages from the
+ * allocator in one go and map them all, rather than paying for a trip
+ * through alloc_pages_node() on every buffer.
+ */
+static void ionic_rx_bulk_alloc(struct ionic_queue *q)
+{
+	struct ionic_page_cache *cache = q->page_cache;
+	struct page *pages[IONIC_RX_BULK_ALLOC] = {};
+	struct ionic_buf_info *buf_info;
+	struct ionic_rx_stats *stats;
+	dma_addr_t dma_addr;
+	unsigned int n, i;
+
+	stats = q_to_rx_stats(q);
+
+	n = alloc_pages_bulk_array_node(IONIC_PAGE_GFP_MASK,
+					READ_ONCE(q->node),
+					IONIC_RX_BULK_ALLOC, pages);
+	for (i = 0; i < n; i++) {
+		dma_addr = dma_map_page(q->dev, pages[i], 0,
+					IONIC_PAGE_SIZE, DMA_FROM_DEVICE);
+		if (unlikely(dma_mapping_error(q->dev, dma_addr))) {
+			stats->dma_map_err++;
+			__free_pages(pages[i], IONIC_PAGE_ORDER);
+			continue;
+		}
+
+		buf_info = &cache->bulk[cache->bulk_avail++];
+		buf_info->page = pages[i];
+		buf_info->dma_addr = dma_addr;
+		buf_info->page_offset = 0;
+	}
+}
+
+static bool ionic_rx_bulk_get(struct ionic_queue *q,
+			      struct ionic_buf_info *buf_info)
+{
+	struct ionic_page_cache *cache = q->page_cache;
+
+	if (!cache->bulk_avail)
+		ionic_rx_bulk_alloc(q);
+	if (!cache->bulk_avail)
+		return false;
+
+	*buf_info = cache->bulk[--cache->bulk_avail];
+	cache->bulk[cache->bulk_avail].page = NULL;
+
+	return true;
+}
+#endif /* HAVE_ALLOC_PAGES_BULK */
+
 static bool ionic_rx_buf_reuse(struct ionic_queue *q,
 			       struct ionic_buf_info *buf_info, u32 used)
 {
@@ -191,7 +465,9 @@ static bool ionic_rx_buf_reuse(struct ionic_queue *q,
 		return false;
 	}
 
-	size = ALIGN(used, IONIC_PAGE_SPLIT_SZ);
+	/* XDP buffers each need their own headroom, so don't split the page */
+	size = ALIGN(used, ionic_rx_headroom(q) ? IONIC_PAGE_SIZE :
+						  IONIC_PAGE_SPLIT_SZ);
 	buf_info->page_offset += size;
 	if (buf_info->page_offset >= IONIC_PAGE_SIZE) {
 		buf_info->page_offset = 0;
@@ -212,20 +488,16 @@ static void ionic_rx_buf_complete(struct ionic_queue *q,
 	if (ionic_rx_buf_reuse(q, buf_info, used))
 		return;
 
-	if (!ionic_rx_cache_put(q, buf_info)) {
-#ifndef HAVE_STRUCT_DMA_ATTRS
-		dma_unmap_page_attrs(q->dev, buf_info->dma_addr, IONIC_PAGE_SIZE,
-				     DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
-#else
-		dma_unmap_page(q->dev, buf_info->dma_addr, IONIC_PAGE_SIZE, DMA_FROM_DEVICE);
-#endif
-	}
+	if (!ionic_rx_cache_put(q, buf_info))
+		ionic_rx_buf_unmap(q, buf_info);
 
 	buf_info->page = NULL;
 }
 
+/* always a whole page here, size only matters to the page_pool */
 static inline int ionic_rx_page_alloc(struct ionic_queue *q,
-				      struct ionic_buf_info *buf_info)
+				      struct ionic_buf_info *buf_info,
+				      unsigned int size)
 {
 	struct net_device *netdev = q->lif->netdev;
 	struct ionic_rx_stats *stats;
@@ -235,6 +507,11 @@ static inline int ionic_rx_page_alloc(struct ionic_queue *q,
 	if (ionic_rx_cache_get(q, buf_info))
 		return 0;
 
+#ifdef HAVE_ALLOC_PAGES_BULK
+	if (ionic_rx_bulk_get(q, buf_info))
+		return 0;
+#endif
+
 	dev = q->dev;
 	stats = q_to_rx_stats(q);
 
@@ -244,7 +521,7 @@ static inline int ionic_rx_page_alloc(struct ionic_queue *q,
 		return -EINVAL;
 	}
 
-	page = alloc_pages_node(dev_to_node(dev), IONIC_PAGE_GFP_MASK, IONIC_PAGE_ORDER);
+	page = alloc_pages_node(READ_ONCE(q->node), IONIC_PAGE_GFP_MASK, IONIC_PAGE_ORDER);
 	if (unlikely(!page)) {
 		net_err_ratelimited("%s: %s page alloc failed\n",
 				    netdev->name, q->name);
@@ -287,27 +564,78 @@ static inline void ionic_rx_page_free(struct ionic_queue *q,
 	__free_pages(buf_info->page, IONIC_PAGE_ORDER);
 	buf_info->page = NULL;
 }
+#endif /* IONIC_PAGE_POOL */
 
 static void ionic_rx_add_skb_frag(struct ionic_queue *q,
 				  struct sk_buff *skb,
 				  struct ionic_buf_info *buf_info,
-				  u32 off, u32 len)
+				  u32 off, u32 len, bool synced)
 {
-	dma_sync_single_for_cpu(q->dev,
-				ionic_rx_buf_pa(buf_info) + off,
-				len, DMA_FROM_DEVICE);
+	if (!synced)
+		dma_sync_single_for_cpu(q->dev,
+					ionic_rx_buf_pa(buf_info) + off,
+					len, DMA_FROM_DEVICE);
 
+#ifdef IONIC_PAGE_POOL
+	skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags,
+			buf_info->page, buf_info->page_offset + off,
+			len,
+			ionic_rx_buf_size(buf_info));
+#else
 	skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags,
 			buf_info->page, buf_info->page_offset + off,
 			len,
 			IONIC_PAGE_SIZE);
+#endif
 
 	ionic_rx_buf_complete(q, buf_info, off + len);
 }
 
+#ifdef IONIC_GRO_HW
+/* Length of the IP and TCP headers of a plain TCP packet starting at nh,
+ * or 0 for anything that can't be aggregated: IP options or fragments,
+ * IPv6 extension headers, or headers running past len.
+ */
+static unsigned int ionic_rx_agg_l3l4_len(const void *nh, unsigned int len,
+					  __be16 proto, unsigned int *thoff)
+{
+	const struct tcphdr *th;
+	unsigned int off;
+
+	if (proto == htons(ETH_P_IP)) {
+		const struct iphdr *iph = nh;
+
+		if (len < sizeof(*iph) || iph->ihl != 5 ||
+		    iph->protocol != IPPROTO_TCP || ip_is_fragment(iph))
+			return 0;
+		off = sizeof(*iph);
+	} else if (proto == htons(ETH_P_IPV6)) {
+		const struct ipv6hdr *ip6h = nh;
+
+		if (len < sizeof(*ip6h) || ip6h->nexthdr != IPPROTO_TCP)
+			return 0;
+		off = sizeof(*ip6h);
+	} else {
+		return 0;
+	}
+
+	if (len < off + sizeof(*th))
+		return 0;
+	th = nh + off;
+	if (th->doff < 5 || len < off + th->doff * 4)
+		return 0;
+
+	*thoff = off;
+	return off + th->doff * 4;
+}
+#endif
+
 static struct sk_buff *ionic_rx_build_skb(struct ionic_queue *q,
 					  struct ionic_desc_info *desc_info,
-					  struct ionic_rxq_comp *comp)
+					  unsigned int headroom,
+					  unsigned int len,
+					  unsigned int num_sg_elems,
+					  bool synced, bool agg)
 {
 	struct net_device *netdev = q->lif->netdev;
 	struct ionic_buf_info *buf_info;
@@ -318,7 +646,6 @@ static struct sk_buff *ionic_rx_build_skb(struct ionic_queue *q,
 	u16 head_len;
 	u16 frag_len;
 	u16 copy_len;
-	u16 len;
 
 	stats = q_to_rx_stats(q);
 
@@ -328,8 +655,30 @@ static struct sk_buff *ionic_rx_build_skb(struct ionic_queue *q,
 
 	prefetchw(buf_info->page);
 
-	len = le16_to_cpu(comp->len);
-	head_len = min_t(u16, q->lif->rx_copybreak, len);
+	/* eth_type_trans() needs at least the Ethernet header linear */
+	head_len = max_t(u32, READ_ONCE(q->copybreak.value), ETH_HLEN);
+	head_len = min_t(u32, head_len, len);
+
+#ifdef IONIC_GRO_HW
+	/* an aggregate candidate gets exactly its headers in the skb head
+	 * so that later segments can be folded in as bare frags
+	 */
+	if (agg) {
+		const struct ethhdr *eth = ionic_rx_buf_va(buf_info) + headroom;
+		unsigned int hdr_len, thoff;
+
+		hdr_len = min_t(u32, len, IONIC_RX_AGG_HDR_MAX);
+		if (!synced)
+			dma_sync_single_for_cpu(dev, ionic_rx_buf_pa(buf_info) + headroom,
+						hdr_len, DMA_FROM_DEVICE);
+		if (hdr_len > ETH_HLEN) {
+			hdr_len = ionic_rx_agg_l3l4_len(eth + 1, hdr_len - ETH_HLEN,
+							eth->h_proto, &thoff);
+			if (hdr_len)
+				head_len = ETH_HLEN + hdr_len;
+		}
+	}
+#endif
 
 	skb = napi_alloc_skb(&q_to_qcq(q)->napi, head_len);
 	if (unlikely(!skb)) {
@@ -339,31 +688,43 @@ static struct sk_buff *ionic_rx_build_skb(struct ionic_queue *q,
 		return NULL;
 	}
 
+#ifdef IONIC_PAGE_POOL
+	skb_mark_for_recycle(skb);
+#endif
+
 	copy_len = ALIGN(head_len, sizeof(long)); /* for better memcpy performance */
-	dma_sync_single_for_cpu(dev, ionic_rx_buf_pa(buf_info), copy_len, DMA_FROM_DEVICE);
-	skb_copy_to_linear_data(skb, ionic_rx_buf_va(buf_info), copy_len);
+	if (!synced)
+		dma_sync_single_for_cpu(dev, ionic_rx_buf_pa(buf_info) + headroom,
+					copy_len, DMA_FROM_DEVICE);
+	skb_copy_to_linear_data(skb, ionic_rx_buf_va(buf_info) + headroom, copy_len);
 	skb_put(skb, head_len);
 
 	if (len > head_len) {
 		len -= head_len;
-		frag_len = min_t(u16, len, ionic_rx_buf_size(buf_info) - head_len);
+		frag_len = min_t(u16, len,
+				 ionic_rx_buf_size(buf_info) - headroom - head_len);
 		len -= frag_len;
-		ionic_rx_add_skb_frag(q, skb, buf_info, head_len, frag_len);
+		ionic_rx_add_skb_frag(q, skb, buf_info, headroom + head_len,
+				      frag_len, synced);
 		buf_info++;
-		for (i = 0; i < comp->num_sg_elems; i++) {
+		for (i = 0; i < num_sg_elems; i++) {
 			if (len == 0)
 				goto err_out;
 			if (unlikely(!buf_info->page))
 				goto err_out;
 			frag_len = min_t(u16, len, ionic_rx_buf_size(buf_info));
 			len -= frag_len;
-			ionic_rx_add_skb_frag(q, skb, buf_info, 0, frag_len);
+			ionic_rx_add_skb_frag(q, skb, buf_info, 0, frag_len, synced);
 			buf_info++;
 		}
 	} else {
-		dma_sync_single_for_device(dev,
-					   ionic_rx_buf_pa(buf_info),
-					   len, DMA_FROM_DEVICE);
+		/* an XDP program may have written anywhere in the buffer */
+		if (synced)
+			len = ionic_rx_buf_size(buf_info) - ionic_rx_headroom(q);
+		dma_sync_single_range_for_device(dev, buf_info->dma_addr,
+						 buf_info->page_offset +
+						 ionic_rx_headroom(q),
+						 len, DMA_FROM_DEVICE);
 	}
 
 	skb->protocol = eth_type_trans(skb, q->lif->netdev);
@@ -376,45 +737,1278 @@ err_out:
 	return NULL;
 }
 
+/* Copy the descriptors posted from start up to head_idx out to the CMB
+ * ring in at most two bursts, one either side of the ring wrap.
+ */
+static void ionic_rxq_cmb_flush(struct ionic_queue *q, unsigned int start)
+{
+	unsigned int end = q->head_idx;
+	unsigned int n;
+
+	n = (end > start ? end : q->num_descs) - start;
+	memcpy_toio(q->info[start].cmb_desc, q->info[start].desc,
+		    n * q->desc_size);
+
+	if (end < start && end)
+		memcpy_toio(q->info[0].cmb_desc, q->info[0].desc,
+			    end * q->desc_size);
+}
+
+/* Hand everything posted since start to the device with one doorbell */
+static void ionic_rx_fill_commit(struct ionic_queue *q, unsigned int start)
+{
+	struct ionic_rx_stats *stats = q_to_rx_stats(q);
+	unsigned int posted;
+
+	posted = (q->head_idx - start) & (q->num_descs - 1);
+	if (!posted)
+		return;
+
+	if (q_to_qcq(q)->flags & IONIC_QCQ_F_CMB_RINGS)
+		ionic_rxq_cmb_flush(q, start);
+
+	stats->refills++;
+	stats->refill_batch = posted;
+
+	ionic_dbell_ring(q->lif->kern_dbpage, q->hw_type,
+			 q->dbval | q->head_idx);
+
+	q->dbell_deadline = IONIC_RX_MIN_DOORBELL_DEADLINE;
+	q->dbell_jiffies = jiffies;
+}
+
+#ifdef IONIC_XDP
+static void ionic_tx_clean(struct ionic_queue *q,
+			   struct ionic_desc_info *desc_info,
+			   struct ionic_cq_info *cq_info,
+			   void *cb_arg);
+static dma_addr_t ionic_tx_map_frag(struct ionic_queue *q,
+				    const skb_frag_t *frag,
+				    size_t offset, size_t len);
+static void ionic_tx_desc_unmap_bufs(struct ionic_queue *q,
+				     struct ionic_desc_info *desc_info);
+#ifdef IONIC_XSK
 static void ionic_rx_clean(struct ionic_queue *q,
 			   struct ionic_desc_info *desc_info,
 			   struct ionic_cq_info *cq_info,
-			   void *cb_arg)
-{
-	struct net_device *netdev = q->lif->netdev;
-	struct ionic_qcq *qcq = q_to_qcq(q);
-	struct ionic_rx_stats *stats;
-	struct ionic_rxq_comp *comp;
-	struct sk_buff *skb;
-#ifdef CSUM_DEBUG
-	__sum16 csum;
+			   void *cb_arg);
 #endif
 
-	comp = cq_info->cq_desc + qcq->cq.desc_size - sizeof(*comp);
+static void ionic_xdp_txq_flush(struct ionic_queue *q)
+{
+	ionic_dbell_ring(q->lif->kern_dbpage, q->hw_type,
+			 q->dbval | q->head_idx);
 
-	stats = q_to_rx_stats(q);
+	q->dbell_jiffies = jiffies;
+	q->dbell_idx = q->head_idx;
+	q->dbell_deferred = false;
+}
 
-	if (comp->status) {
-		stats->dropped++;
+/* XDP goes out on its own txqs when the LIF has them, one per CPU if
+ * there are enough, otherwise on the stack's txq for this queue pair.
+ */
+static struct ionic_queue *ionic_xdp_txq(struct ionic_lif *lif,
+					 unsigned int qi)
+{
+	if (lif->nxdp_txqs)
+		return &lif->xdp_txqcqs[smp_processor_id() % lif->nxdp_txqs]->q;
+
+	return &lif->txqcqs[qi]->q;
+}
+
+static void ionic_xdp_txq_lock(struct ionic_queue *q)
+{
+	struct netdev_queue *nq;
+
+	/* uncontended unless CPUs share it or the dbell sweep is here */
+	if (q_to_qcq(q)->flags & IONIC_QCQ_F_XDP) {
+		spin_lock(&q->xdp_lock);
 		return;
 	}
 
-	if (le16_to_cpu(comp->len) > netdev->mtu + ETH_HLEN + VLAN_HLEN) {
-		stats->dropped++;
-		net_warn_ratelimited("%s: RX PKT TOO LARGE! comp->len %d\n",
-				     netdev->name,
-				     le16_to_cpu(comp->len));
+	/* The stack may be using this txq too, so we take its lock */
+	nq = netdev_get_tx_queue(q->lif->netdev, q->index);
+	__netif_tx_lock(nq, smp_processor_id());
+	txq_trans_cond_update(nq);
+}
+
+static void ionic_xdp_txq_unlock(struct ionic_queue *q)
+{
+	if (q_to_qcq(q)->flags & IONIC_QCQ_F_XDP) {
+		spin_unlock(&q->xdp_lock);
 		return;
 	}
 
-	stats->pkts++;
-	stats->bytes += le16_to_cpu(comp->len);
+	__netif_tx_unlock(netdev_get_tx_queue(q->lif->netdev, q->index));
+}
 
-	skb = ionic_rx_build_skb(q, desc_info, comp);
-	if (unlikely(!skb)) {
-		stats->dropped++;
+/* An xdp txq has no interrupt, its completions are reaped by whoever
+ * posts to it.  Caller holds the xdp txq lock.
+ */
+static void ionic_xdp_txq_reap(struct ionic_queue *q, int budget)
+{
+	if (!(q_to_qcq(q)->flags & IONIC_QCQ_F_XDP) ||
+	    q->tail_idx == q->head_idx)
+		return;
+
+	ionic_tx_cq_service(&q_to_qcq(q)->cq, q->num_descs, budget);
+}
+
+/* Called from the dbell sweep, so that an xdp txq whose CPU has gone
+ * quiet still gives its frames back, and a doorbell that went missing
+ * is rung again once the deadline has passed.
+ */
+void ionic_xdp_txq_service(struct ionic_queue *q)
+{
+	spin_lock_bh(&q->xdp_lock);
+
+	ionic_xdp_txq_reap(q, 0);
+
+	if (q->tail_idx != q->head_idx &&
+	    time_after(jiffies, q->dbell_jiffies + q->dbell_deadline)) {
+		ionic_xdp_txq_flush(q);
+		q_to_tx_stats(q)->dbell_pokes++;
+	}
+
+	spin_unlock_bh(&q->xdp_lock);
+}
+
+static bool ionic_xdp_txq_has_space(struct ionic_queue *q)
+{
+	if (ionic_q_has_space(q, 1))
+		return true;
+
+	ionic_xdp_txq_reap(q, 0);
+
+	return ionic_q_has_space(q, 1);
+}
+
+/* Caller must hold the xdp txq lock and have checked for space */
+static int ionic_xdp_post_frame(struct ionic_queue *q, struct xdp_frame *xdpf)
+{
+	struct ionic_desc_info *desc_info = &q->info[q->head_idx];
+	struct ionic_tx_stats *stats = q_to_tx_stats(q);
+	struct ionic_buf_info *buf_info = desc_info->bufs;
+	struct ionic_txq_desc *desc = desc_info->txq_desc;
+	struct skb_shared_info *sinfo = NULL;
+	struct ionic_txq_sg_elem *elem;
+	unsigned int bytes = xdpf->len;
+	unsigned int nfrags = 0;
+	dma_addr_t dma_addr;
+	skb_frag_t *frag;
+	unsigned int i;
+	u64 cmd;
+
+	if (xdp_frame_has_frags(xdpf)) {
+		sinfo = xdp_get_shared_info_from_frame(xdpf);
+		nfrags = sinfo->nr_frags;
+		if (nfrags > q->max_sg_elems)
+			return -EIO;
+	}
+
+	dma_addr = dma_map_single(q->dev, xdpf->data, xdpf->len, DMA_TO_DEVICE);
+	if (dma_mapping_error(q->dev, dma_addr)) {
+		net_warn_ratelimited("%s: DMA single map failed on %s!\n",
+				     q->lif->netdev->name, q->name);
+		stats->dma_map_err++;
+		return -EIO;
+	}
+
+	buf_info->dma_addr = dma_addr;
+	buf_info->len = xdpf->len;
+	desc_info->nbufs = 1;
+
+	/* the rest of a multi-buffer frame goes out on the sg elements */
+	elem = desc_info->txq_sg_desc->elems;
+	for (i = 0; i < nfrags; i++, elem++) {
+		frag = &sinfo->frags[i];
+		buf_info++;
+		buf_info->dma_addr = ionic_tx_map_frag(q, frag, 0,
+						       skb_frag_size(frag));
+		if (dma_mapping_error(q->dev, buf_info->dma_addr)) {
+			ionic_tx_desc_unmap_bufs(q, desc_info);
+			return -EIO;
+		}
+		buf_info->len = skb_frag_size(frag);
+		desc_info->nbufs++;
+
+		elem->addr = cpu_to_le64(buf_info->dma_addr);
+		elem->len = cpu_to_le16(buf_info->len);
+		bytes += buf_info->len;
+	}
+
+	desc_info->xdpf = xdpf;
+
+	cmd = encode_txq_desc_cmd(IONIC_TXQ_DESC_OPCODE_CSUM_NONE,
+				  0, nfrags, dma_addr);
+	desc->cmd = cpu_to_le64(cmd);
+	desc->len = cpu_to_le16(xdpf->len);
+	desc->vlan_tci = 0;
+	desc->csum_start = 0;
+	desc->csum_offset = 0;
+
+	/* commit CMB descriptor contents in one shot */
+	if (q_to_qcq(q)->flags & IONIC_QCQ_F_CMB_RINGS)
+		memcpy_toio(desc_info->cmb_desc, desc, q->desc_size);
+
+	stats->xdp_frames++;
+	stats->pkts++;
+	stats->bytes += bytes;
+
+	ionic_txq_post(q, false, ionic_tx_clean, NULL);
+
+	return 0;
+}
+
+int ionic_xdp_xmit(struct net_device *netdev, int n,
+		   struct xdp_frame **xdp_frames, u32 flags)
+{
+	struct ionic_lif *lif = netdev_priv(netdev);
+	struct ionic_queue *q;
+	int nxmit;
+
+	if (unlikely(!test_bit(IONIC_LIF_F_UP, lif->state)))
+		return -ENETDOWN;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	q = ionic_xdp_txq(lif, smp_processor_id() % lif->nxqs);
+	ionic_xdp_txq_lock(q);
+
+	for (nxmit = 0; nxmit < n; nxmit++) {
+		if (!ionic_xdp_txq_has_space(q))
+			break;
+		if (ionic_xdp_post_frame(q, xdp_frames[nxmit]))
+			break;
+	}
+
+	if (nxmit && (flags & XDP_XMIT_FLUSH))
+		ionic_xdp_txq_flush(q);
+
+	ionic_xdp_txq_unlock(q);
+
+	return nxmit;
+}
+
+/* Give a buffer that XDP dropped straight back to the device */
+static void ionic_xdp_rx_recycle(struct ionic_queue *q,
+				 struct ionic_buf_info *buf_info)
+{
+	dma_sync_single_range_for_device(q->dev, buf_info->dma_addr,
+					 buf_info->page_offset + XDP_PACKET_HEADROOM,
+					 ionic_rx_buf_size(buf_info) - XDP_PACKET_HEADROOM,
+					 DMA_FROM_DEVICE);
+}
+
+#ifdef IONIC_XDP_MB
+/* Hang the rest of a jumbo frame off the xdp_buff as frags.  The frag
+ * pages belong to the xdp_buff from here on, whatever the verdict.
+ */
+static void ionic_xdp_add_frags(struct ionic_queue *rxq,
+				struct xdp_buff *xdp_buf,
+				struct ionic_buf_info *buf_info,
+				unsigned int num_sg_elems,
+				unsigned int len)
+{
+	struct skb_shared_info *sinfo;
+	unsigned int frag_len;
+	skb_frag_t *frag;
+	unsigned int i;
+
+	sinfo = xdp_get_shared_info_from_buff(xdp_buf);
+	sinfo->nr_frags = 0;
+	sinfo->xdp_frags_size = 0;
+	xdp_buff_set_frags_flag(xdp_buf);
+
+	for (i = 0; len && i < num_sg_elems; i++, buf_info++) {
+		if (unlikely(!buf_info->page))
+			break;
+
+		frag_len = min_t(unsigned int, len, ionic_rx_buf_size(buf_info));
+		dma_sync_single_range_for_cpu(rxq->dev, buf_info->dma_addr,
+					      buf_info->page_offset, frag_len,
+					      DMA_FROM_DEVICE);
+
+		frag = &sinfo->frags[sinfo->nr_frags++];
+		skb_frag_fill_page_desc(frag, buf_info->page,
+					buf_info->page_offset, frag_len);
+		sinfo->xdp_frags_size += frag_len;
+		if (page_is_pfmemalloc(buf_info->page))
+			xdp_buff_set_frag_pfmemalloc(xdp_buf);
+
+		buf_info->page = NULL;
+		len -= frag_len;
+	}
+}
+
+/* Give back whatever frags the program left on a dropped frame */
+static void ionic_xdp_put_frags(struct ionic_queue *rxq,
+				struct xdp_buff *xdp_buf)
+{
+	struct skb_shared_info *sinfo;
+	unsigned int i;
+
+	if (!xdp_buff_has_frags(xdp_buf))
+		return;
+
+	sinfo = xdp_get_shared_info_from_buff(xdp_buf);
+	for (i = 0; i < sinfo->nr_frags; i++)
+		page_pool_put_full_page(rxq->page_pool,
+					skb_frag_page(&sinfo->frags[i]), true);
+	sinfo->nr_frags = 0;
+}
+
+/* XDP_PASS on a multi-buffer frame: the skb is built around the first
+ * buffer, and inherits the frags already sitting in its shared info.
+ */
+static struct sk_buff *ionic_xdp_build_skb(struct ionic_queue *rxq,
+					   struct ionic_buf_info *buf_info,
+					   struct xdp_buff *xdp_buf)
+{
+	struct skb_shared_info *sinfo;
+	unsigned int frags_size;
+	unsigned int nr_frags;
+	struct sk_buff *skb;
+
+	/* build_skb() clears these, so grab them first */
+	sinfo = xdp_get_shared_info_from_buff(xdp_buf);
+	nr_frags = sinfo->nr_frags;
+	frags_size = sinfo->xdp_frags_size;
+
+	skb = build_skb(xdp_buf->data_hard_start, xdp_buf->frame_sz);
+	if (unlikely(!skb)) {
+		ionic_xdp_put_frags(rxq, xdp_buf);
+		ionic_xdp_rx_recycle(rxq, buf_info);
+		return NULL;
+	}
+
+	skb_mark_for_recycle(skb);
+	skb_reserve(skb, xdp_buf->data - xdp_buf->data_hard_start);
+	__skb_put(skb, xdp_buf->data_end - xdp_buf->data);
+	xdp_update_skb_shared_info(skb, nr_frags, frags_size,
+				   nr_frags * IONIC_PAGE_SIZE,
+				   xdp_buff_is_frag_pfmemalloc(xdp_buf));
+
+	/* the head page went with the skb */
+	buf_info->page = NULL;
+
+	skb->protocol = eth_type_trans(skb, rxq->lif->netdev);
+
+	return skb;
+}
+#else
+static inline void ionic_xdp_put_frags(struct ionic_queue *rxq,
+				       struct xdp_buff *xdp_buf) {}
+#endif /* IONIC_XDP_MB */
+
+/* Returns true if XDP consumed the packet, else the caller builds the skb
+ * from the possibly adjusted headroom and len, or from xdp_buf if it
+ * grew frags.
+ */
+static bool ionic_run_xdp(struct ionic_rx_stats *stats,
+			  struct net_device *netdev,
+			  struct bpf_prog *xdp_prog,
+			  struct ionic_queue *rxq,
+			  struct ionic_desc_info *desc_info,
+			  unsigned int num_sg_elems,
+			  struct xdp_buff *xdp_buf,
+			  unsigned int *headroom,
+			  unsigned int *len)
+{
+	struct ionic_buf_info *buf_info = desc_info->bufs;
+	struct ionic_queue *txq;
+	struct xdp_frame *xdpf;
+	unsigned int head_len;
+	u32 xdp_action;
+	int err;
+
+	head_len = min_t(unsigned int, *len, ionic_rx_buf_size(buf_info) -
+					     *headroom - ionic_rx_tailroom(rxq));
+
+	xdp_init_buff(xdp_buf, ionic_rx_buf_size(buf_info), rxq->xdp_rxq_info);
+	xdp_prepare_buff(xdp_buf, ionic_rx_buf_va(buf_info),
+			 *headroom, head_len, false);
+
+	dma_sync_single_range_for_cpu(rxq->dev, buf_info->dma_addr,
+				      buf_info->page_offset + *headroom,
+				      head_len, DMA_FROM_DEVICE);
+
+#ifdef IONIC_XDP_MB
+	if (*len > head_len)
+		ionic_xdp_add_frags(rxq, xdp_buf, buf_info + 1,
+				    num_sg_elems, *len - head_len);
+#endif
+
+	prefetchw(&xdp_buf->data_hard_start);
+
+	xdp_action = bpf_prog_run_xdp(xdp_prog, xdp_buf);
+
+	switch (xdp_action) {
+	case XDP_PASS:
+		stats->xdp_pass++;
+		*headroom = xdp_buf->data - xdp_buf->data_hard_start;
+		*len = xdp_buf->data_end - xdp_buf->data;
+		return false;
+
+	case XDP_DROP:
+		ionic_xdp_put_frags(rxq, xdp_buf);
+		ionic_xdp_rx_recycle(rxq, buf_info);
+		stats->xdp_drop++;
+		return true;
+
+	case XDP_TX:
+		xdpf = xdp_convert_buff_to_frame(xdp_buf);
+		if (!xdpf)
+			goto out_xdp_abort;
+
+		txq = ionic_xdp_txq(rxq->lif, rxq->index);
+		ionic_xdp_txq_lock(txq);
+
+		if (!ionic_xdp_txq_has_space(txq)) {
+			ionic_xdp_txq_unlock(txq);
+			goto out_xdp_abort;
+		}
+
+		/* the page belongs to the txq from here on */
+#ifndef IONIC_PAGE_POOL
+		ionic_rx_buf_unmap(rxq, buf_info);
+#endif
+		buf_info->page = NULL;
+
+		err = ionic_xdp_post_frame(txq, xdpf);
+		ionic_xdp_txq_unlock(txq);
+		if (err) {
+			xdp_return_frame(xdpf);
+			goto out_xdp_exception;
+		}
+
+		rxq->xdp_tx_pending = true;
+		stats->xdp_tx++;
+		return true;
+
+	case XDP_REDIRECT:
+#ifdef IONIC_PAGE_POOL
+		err = xdp_do_redirect(netdev, xdp_buf, xdp_prog);
+		if (err) {
+			/* the head page and any frags */
+			xdp_return_buff(xdp_buf);
+			buf_info->page = NULL;
+			goto out_xdp_exception;
+		}
+#else
+		/* the page must be unmapped before another device sees it */
+		ionic_rx_buf_unmap(rxq, buf_info);
+		err = xdp_do_redirect(netdev, xdp_buf, xdp_prog);
+		if (err) {
+			put_page(buf_info->page);
+			buf_info->page = NULL;
+			goto out_xdp_exception;
+		}
+#endif
+
+		buf_info->page = NULL;
+		rxq->xdp_flush = true;
+		stats->xdp_redirect++;
+		return true;
+
+	default:
+		bpf_warn_invalid_xdp_action(netdev, xdp_prog, xdp_action);
+		fallthrough;
+	case XDP_ABORTED:
+		goto out_xdp_abort;
+	}
+
+out_xdp_abort:
+	ionic_xdp_put_frags(rxq, xdp_buf);
+	ionic_xdp_rx_recycle(rxq, buf_info);
+out_xdp_exception:
+	trace_xdp_exception(netdev, xdp_prog, xdp_action);
+	stats->xdp_aborted++;
+
+	return true;
+}
+
+/* Called once per NAPI poll to push out what XDP queued up, and to
+ * reap what this CPU's xdp txq has finished sending.
+ */
+static void ionic_xdp_rx_flush(struct ionic_queue *rxq, int budget)
+{
+	struct ionic_queue *txq;
+
+	if (rxq->xdp_flush) {
+		xdp_do_flush();
+		rxq->xdp_flush = false;
+	}
+
+	if (!rxq->xdp_tx_pending && !rxq->lif->nxdp_txqs)
+		return;
+
+	txq = ionic_xdp_txq(rxq->lif, rxq->index);
+	ionic_xdp_txq_lock(txq);
+	if (rxq->xdp_tx_pending) {
+		ionic_xdp_txq_flush(txq);
+		rxq->xdp_tx_pending = false;
+	}
+	ionic_xdp_txq_reap(txq, budget);
+	ionic_xdp_txq_unlock(txq);
+}
+#else
+static inline void ionic_xdp_rx_flush(struct ionic_queue *rxq, int budget) {}
+#endif /* IONIC_XDP */
+
+#ifdef IONIC_XSK
+/* AF_XDP zero-copy receive.  The frame lives in the socket's UMEM, so
+ * anything the program doesn't redirect into the socket or bounce back
+ * out is copied into a fresh skb and the frame handed back to the pool.
+ */
+static struct sk_buff *ionic_xsk_rx_skb(struct ionic_queue *q,
+					struct ionic_desc_info *desc_info,
+					unsigned int len)
+{
+	struct ionic_rx_stats *stats = q_to_rx_stats(q);
+	struct net_device *netdev = q->lif->netdev;
+	struct xdp_buff *xdp = desc_info->xsk_buf;
+	struct bpf_prog *xdp_prog;
+	struct ionic_queue *txq;
+	struct xdp_frame *xdpf;
+	struct sk_buff *skb;
+	u32 xdp_action;
+	int err;
+
+	if (unlikely(!xdp)) {
+		stats->dropped++;
+		return NULL;
+	}
+	desc_info->xsk_buf = NULL;
+
+	xsk_buff_set_size(xdp, len);
+#ifdef HAVE_XSK_BUFF_DMA_SYNC_POOL
+	xsk_buff_dma_sync_for_cpu(xdp, q->xsk_pool);
+#else
+	xsk_buff_dma_sync_for_cpu(xdp);
+#endif
+	stats->xsk_frames++;
+
+	xdp_prog = READ_ONCE(q->xdp_prog);
+	xdp_action = xdp_prog ? bpf_prog_run_xdp(xdp_prog, xdp) : XDP_PASS;
+
+	switch (xdp_action) {
+	case XDP_REDIRECT:
+		err = xdp_do_redirect(netdev, xdp, xdp_prog);
+		if (err)
+			goto out_xdp_abort;
+
+		q->xdp_flush = true;
+		stats->xdp_redirect++;
+		return NULL;
+
+	case XDP_PASS:
+		break;
+
+	case XDP_DROP:
+		xsk_buff_free(xdp);
+		stats->xdp_drop++;
+		return NULL;
+
+	case XDP_TX:
+		/* copies the frame out and gives the UMEM frame back */
+		xdpf = xdp_convert_buff_to_frame(xdp);
+		if (!xdpf)
+			goto out_xdp_abort;
+
+		txq = ionic_xdp_txq(q->lif, q->index);
+		ionic_xdp_txq_lock(txq);
+		if (ionic_xdp_txq_has_space(txq))
+			err = ionic_xdp_post_frame(txq, xdpf);
+		else
+			err = -ENOSPC;
+		ionic_xdp_txq_unlock(txq);
+		if (err) {
+			xdp_return_frame(xdpf);
+			trace_xdp_exception(netdev, xdp_prog, xdp_action);
+			stats->xdp_aborted++;
+			return NULL;
+		}
+
+		q->xdp_tx_pending = true;
+		stats->xdp_tx++;
+		return NULL;
+
+	default:
+		bpf_warn_invalid_xdp_action(netdev, xdp_prog, xdp_action);
+		fallthrough;
+	case XDP_ABORTED:
+		goto out_xdp_abort;
+	}
+
+	if (xdp_prog)
+		stats->xdp_pass++;
+
+	len = xdp->data_end - xdp->data;
+	skb = napi_alloc_skb(&q_to_qcq(q)->napi, len);
+	if (unlikely(!skb)) {
+		net_warn_ratelimited("%s: SKB alloc failed on %s!\n",
+				     netdev->name, q->name);
+		stats->alloc_err++;
+		stats->dropped++;
+		xsk_buff_free(xdp);
+		return NULL;
+	}
+
+	skb_put_data(skb, xdp->data, len);
+	xsk_buff_free(xdp);
+
+	skb->protocol = eth_type_trans(skb, netdev);
+
+	return skb;
+
+out_xdp_abort:
+	trace_xdp_exception(netdev, xdp_prog, xdp_action);
+	xsk_buff_free(xdp);
+	stats->xdp_aborted++;
+
+	return NULL;
+}
+
+static void ionic_xsk_rx_fill(struct ionic_queue *q, unsigned int n_fill)
+{
+	struct xsk_buff_pool *pool = q->xsk_pool;
+	struct ionic_desc_info *desc_info;
+	struct ionic_rxq_sg_desc *sg_desc;
+	struct ionic_rxq_desc *desc;
+	unsigned int frame_len;
+	unsigned int start;
+	unsigned int i;
+
+	frame_len = xsk_pool_get_rx_frame_size(pool);
+	start = q->head_idx;
+
+	for (i = n_fill; i; i--) {
+		desc_info = &q->info[q->head_idx];
+		desc = desc_info->desc;
+
+		if (!desc_info->xsk_buf) {
+			desc_info->xsk_buf = xsk_buff_alloc(pool);
+			if (!desc_info->xsk_buf)
+				break;	/* fill ring is empty */
+		}
+
+		/* one UMEM frame per packet, the MTU was checked to fit */
+		desc->addr = cpu_to_le64(xsk_buff_xdp_get_dma(desc_info->xsk_buf));
+		desc->len = cpu_to_le16(frame_len);
+		desc->opcode = IONIC_RXQ_DESC_OPCODE_SIMPLE;
+		desc_info->nbufs = 0;
+		desc_info->sg_stale = true;
+
+		/* clear the first sg element as a sentinel */
+		sg_desc = desc_info->sg_desc;
+		memset(&sg_desc->elems[0], 0, sizeof(sg_desc->elems[0]));
+
+		ionic_rxq_post(q, false, ionic_rx_clean, NULL);
+	}
+
+	/* ask userspace to kick us when it has refilled the fill ring */
+	if (xsk_uses_need_wakeup(pool)) {
+		if (i)
+			xsk_set_rx_need_wakeup(pool);
+		else
+			xsk_clear_rx_need_wakeup(pool);
+	}
+
+	ionic_rx_fill_commit(q, start);
+}
+
+/* Drain the socket's TX ring onto the queue, returns false if there was
+ * more to send than the budget allowed.  Runs in the queue's NAPI.
+ */
+static bool ionic_xsk_tx_xmit(struct ionic_queue *q, unsigned int budget)
+{
+	struct ionic_tx_stats *stats = q_to_tx_stats(q);
+	struct xsk_buff_pool *pool = q->xsk_pool;
+	struct ionic_desc_info *desc_info;
+	struct ionic_txq_desc *desc;
+	struct netdev_queue *nq;
+	struct xdp_desc xsk_desc;
+	unsigned int sent = 0;
+	dma_addr_t dma_addr;
+	u64 cmd;
+
+	nq = q_to_ndq(q);
+	__netif_tx_lock(nq, smp_processor_id());
+	txq_trans_cond_update(nq);
+
+	if (q->xsk_tx_done) {
+		xsk_tx_completed(pool, q->xsk_tx_done);
+		q->xsk_tx_done = 0;
+	}
+
+	while (sent < budget && ionic_q_has_space(q, 1)) {
+		if (!xsk_tx_peek_desc(pool, &xsk_desc))
+			break;
+
+		dma_addr = xsk_buff_raw_get_dma(pool, xsk_desc.addr);
+		xsk_buff_raw_dma_sync_for_device(pool, dma_addr, xsk_desc.len);
+
+		desc_info = &q->info[q->head_idx];
+		desc = desc_info->txq_desc;
+
+		/* the UMEM stays mapped by the pool, nothing to unmap */
+		desc_info->nbufs = 0;
+		desc_info->xsk_tx = true;
+
+		cmd = encode_txq_desc_cmd(IONIC_TXQ_DESC_OPCODE_CSUM_NONE,
+					  0, 0, dma_addr);
+		desc->cmd = cpu_to_le64(cmd);
+		desc->len = cpu_to_le16(xsk_desc.len);
+		desc->vlan_tci = 0;
+		desc->csum_start = 0;
+		desc->csum_offset = 0;
+
+		/* commit CMB descriptor contents in one shot */
+		if (q_to_qcq(q)->flags & IONIC_QCQ_F_CMB_RINGS)
+			memcpy_toio(desc_info->cmb_desc, desc, q->desc_size);
+
+		stats->xsk_frames++;
+		stats->pkts++;
+		stats->bytes += xsk_desc.len;
+
+		ionic_txq_post(q, false, ionic_tx_clean, NULL);
+		sent++;
+	}
+
+	if (sent) {
+		xsk_tx_release(pool);
+		ionic_xdp_txq_flush(q);
+	}
+
+	if (xsk_uses_need_wakeup(pool))
+		xsk_set_tx_need_wakeup(pool);
+
+	__netif_tx_unlock(nq);
+
+	return sent < budget;
+}
+
+static void ionic_xsk_kick_napi(struct napi_struct *napi)
+{
+	if (napi_if_scheduled_mark_missed(napi))
+		return;
+
+	local_bh_disable();
+	napi_schedule(napi);
+	local_bh_enable();
+}
+
+int ionic_xsk_wakeup(struct net_device *netdev, u32 qid, u32 flags)
+{
+	struct ionic_lif *lif = netdev_priv(netdev);
+	bool split;
+
+	if (unlikely(!test_bit(IONIC_LIF_F_UP, lif->state)))
+		return -ENETDOWN;
+
+	if (qid >= lif->nxqs || !lif->rxqcqs[qid]->q.xsk_pool)
+		return -EINVAL;
+
+	/* with split interrupts the tx side has a napi of its own */
+	split = test_bit(IONIC_LIF_F_SPLIT_INTR, lif->state);
+	if (split && (flags & XDP_WAKEUP_TX))
+		ionic_xsk_kick_napi(&lif->txqcqs[qid]->napi);
+	if (!split || (flags & XDP_WAKEUP_RX))
+		ionic_xsk_kick_napi(&lif->rxqcqs[qid]->napi);
+
+	return 0;
+}
+#endif /* IONIC_XSK */
+
+/* Header split: the device fills the header buffer first, so the skb
+ * head is built around it in place and the rest of the packet is hung
+ * off the payload pages, with no copy at all.
+ */
+static struct sk_buff *ionic_rx_hdr_split_skb(struct ionic_queue *q,
+					      struct ionic_desc_info *desc_info,
+					      unsigned int len,
+					      unsigned int num_sg_elems)
+{
+	struct net_device *netdev = q->lif->netdev;
+	struct ionic_buf_info *buf_info;
+	struct ionic_rx_stats *stats;
+	struct sk_buff *skb;
+	unsigned int hdr_len;
+	unsigned int i;
+	u16 frag_len;
+	void *va;
+
+	stats = q_to_rx_stats(q);
+
+	buf_info = &desc_info->bufs[0];
+	if (unlikely(!buf_info->page))
+		return NULL;
+
+	hdr_len = min_t(unsigned int, len, IONIC_RX_HDR_SZ);
+	dma_sync_single_for_cpu(q->dev,
+				ionic_rx_buf_pa(buf_info) + NET_SKB_PAD,
+				hdr_len, DMA_FROM_DEVICE);
+
+	va = ionic_rx_buf_va(buf_info);
+	prefetch(va + NET_SKB_PAD);
+
+	skb = build_skb(va, IONIC_RX_HDR_BUF_SZ);
+	if (unlikely(!skb)) {
+		net_warn_ratelimited("%s: SKB build failed on %s!\n",
+				     netdev->name, q->name);
+		stats->alloc_err++;
+		return NULL;
+	}
+
+#ifdef IONIC_PAGE_POOL
+	skb_mark_for_recycle(skb);
+#endif
+
+	skb_reserve(skb, NET_SKB_PAD);
+	skb_put(skb, hdr_len);
+	ionic_rx_buf_complete(q, buf_info, IONIC_RX_HDR_BUF_SZ);
+
+	len -= hdr_len;
+	buf_info++;
+	for (i = 0; len && i < num_sg_elems; i++) {
+		if (unlikely(!buf_info->page))
+			goto err_out;
+		frag_len = min_t(u16, len, ionic_rx_buf_size(buf_info));
+		len -= frag_len;
+		ionic_rx_add_skb_frag(q, skb, buf_info, 0, frag_len, false);
+		buf_info++;
+	}
+	if (unlikely(len))
+		goto err_out;
+
+	if (skb_shinfo(skb)->nr_frags)
+		stats->hdr_split++;
+	else
+		stats->hdr_only++;
+
+	skb->protocol = eth_type_trans(skb, netdev);
+
+	return skb;
+
+err_out:
+	dev_kfree_skb(skb);
+	return NULL;
+}
+
+/* Returns the skb for a page backed rx buffer, or NULL if XDP consumed
+ * the packet or it had to be dropped
+ */
+static struct sk_buff *ionic_rx_page_skb(struct ionic_queue *q,
+					 struct ionic_desc_info *desc_info,
+					 unsigned int len,
+					 unsigned int num_sg_elems,
+					 bool agg)
+{
+	struct ionic_rx_stats *stats = q_to_rx_stats(q);
+#ifdef IONIC_XDP
+	struct bpf_prog *xdp_prog;
+	struct xdp_buff xdp_buf;
+#endif
+	unsigned int headroom;
+	struct sk_buff *skb;
+	bool synced = false;
+
+	if (q->hdr_split) {
+		skb = ionic_rx_hdr_split_skb(q, desc_info, len, num_sg_elems);
+		if (unlikely(!skb))
+			stats->dropped++;
+		return skb;
+	}
+
+	headroom = ionic_rx_headroom(q);
+
+#ifdef IONIC_XDP
+	xdp_prog = READ_ONCE(q->xdp_prog);
+	if (xdp_prog) {
+		if (ionic_run_xdp(stats, q->lif->netdev, xdp_prog, q,
+				  desc_info, num_sg_elems, &xdp_buf,
+				  &headroom, &len))
+			return NULL;
+#ifdef IONIC_XDP_MB
+		if (xdp_buff_has_frags(&xdp_buf)) {
+			skb = ionic_xdp_build_skb(q, desc_info->bufs, &xdp_buf);
+			if (unlikely(!skb))
+				stats->dropped++;
+			return skb;
+		}
+#endif
+		synced = true;
+	}
+#endif
+
+	skb = ionic_rx_build_skb(q, desc_info, headroom, len,
+				 num_sg_elems, synced, agg);
+	if (unlikely(!skb))
+		stats->dropped++;
+
+	return skb;
+}
+
+static inline unsigned int ionic_rx_size_bucket(unsigned int len)
+{
+	if (len <= BIT(IONIC_RX_SIZE_BUCKET_SHIFT))
+		return 0;
+
+	return min_t(unsigned int, fls(len - 1) - IONIC_RX_SIZE_BUCKET_SHIFT,
+		     IONIC_RX_SIZE_BUCKETS - 1);
+}
+
+static inline unsigned int ionic_rx_size_bucket_max(unsigned int bucket)
+{
+	return BIT(IONIC_RX_SIZE_BUCKET_SHIFT + bucket);
+}
+
+/* Small-RPC queues get a copybreak just big enough to swallow most of
+ * their packets whole, bulk queues stop copying anything past the
+ * Ethernet header, and mixed traffic keeps whatever it had.
+ */
+static void ionic_rx_copybreak_adapt(struct ionic_queue *q,
+				     struct ionic_rx_stats *stats)
+{
+	struct ionic_rx_copybreak *cb = &q->copybreak;
+	u32 win[IONIC_RX_SIZE_BUCKETS];
+	u32 small = 0, covered = 0;
+	unsigned int b, nb;
+	u32 ceiling;
+
+	for (b = 0; b < IONIC_RX_SIZE_BUCKETS; b++) {
+		win[b] = stats->size_hist[b] - cb->hist_base[b];
+		cb->hist_base[b] = stats->size_hist[b];
+	}
+	cb->window = 0;
+
+	if (!READ_ONCE(cb->adaptive))
+		return;
+
+	/* only whole buckets under the ceiling count as hits */
+	ceiling = READ_ONCE(cb->ceiling);
+	for (nb = 0; nb < IONIC_RX_SIZE_BUCKETS - 1 &&
+		     ionic_rx_size_bucket_max(nb) <= ceiling; nb++)
+		small += win[nb];
+
+	if (small * 100 < IONIC_RX_CB_WINDOW * IONIC_RX_CB_HIT_LO) {
+		WRITE_ONCE(cb->value, 0);
+		return;
+	}
+
+	if (small * 100 < IONIC_RX_CB_WINDOW * IONIC_RX_CB_HIT_HI)
+		return;
+
+	for (b = 0; b < nb - 1; b++) {
+		covered += win[b];
+		if (covered * 100 >= small * IONIC_RX_CB_COVER)
+			break;
+	}
+	WRITE_ONCE(cb->value, ionic_rx_size_bucket_max(b));
+}
+
+#ifdef IONIC_GRO_HW
+#define IONIC_RX_AGG_TCP_FLAGS_BAD	(TCP_FLAG_SYN | TCP_FLAG_FIN | \
+					 TCP_FLAG_RST | TCP_FLAG_URG | \
+					 TCP_FLAG_CWR | TCP_FLAG_ECE)
+
+/* Only TCP the device didn't flag as bad, with no timestamp to keep */
+static inline bool ionic_rx_agg_wanted(struct ionic_queue *q,
+				       struct ionic_rxq_comp *comp)
+{
+	switch (comp->pkt_type_color & IONIC_RXQ_COMP_PKT_TYPE_MASK) {
+	case IONIC_PKT_TYPE_IPV4_TCP:
+	case IONIC_PKT_TYPE_IPV6_TCP:
+		break;
+	default:
+		return false;
+	}
+
+	return (q->lif->netdev->features & NETIF_F_GRO_HW) &&
+	       !(q->features & IONIC_RXQ_F_HWSTAMP) &&
+	       !(comp->csum_flags & (IONIC_RXQ_COMP_CSUM_F_TCP_BAD |
+				     IONIC_RXQ_COMP_CSUM_F_IP_BAD));
+}
+
+/* The TCP checksum is either vouched for by the device, or checked here
+ * against the CHECKSUM_COMPLETE value, since the aggregate's checksum
+ * state will no longer say anything about the individual segments.
+ */
+static bool ionic_rx_agg_csum_ok(struct sk_buff *skb, u8 csum_flags,
+				 unsigned int thoff)
+{
+	unsigned int tcplen = skb->len - thoff;
+	__wsum csum;
+
+	if (csum_flags & IONIC_RXQ_COMP_CSUM_F_TCP_OK)
+		return true;
+
+	if (skb->ip_summed != CHECKSUM_COMPLETE)
+		return false;
+
+	csum = csum_sub(skb->csum, csum_partial(skb->data, thoff, 0));
+	if (skb->protocol == htons(ETH_P_IP))
+		return !csum_tcpudp_magic(ip_hdr(skb)->saddr, ip_hdr(skb)->daddr,
+					  tcplen, IPPROTO_TCP, csum);
+
+	return !csum_ipv6_magic(&ipv6_hdr(skb)->saddr, &ipv6_hdr(skb)->daddr,
+				tcplen, IPPROTO_TCP, csum);
+}
+
+static bool ionic_rx_agg_match(struct ionic_rx_agg *agg, struct sk_buff *skb,
+			       unsigned int hlen, unsigned int plen)
+{
+	struct sk_buff *head = agg->skb;
+	const struct tcphdr *th, *th0;
+
+	if (hlen != agg->hlen || plen > agg->mss ||
+	    skb->protocol != head->protocol || skb->hash != head->hash)
+		return false;
+
+	if (head->len + plen > IONIC_RX_AGG_MAX_LEN ||
+	    skb_shinfo(head)->nr_frags + skb_shinfo(skb)->nr_frags > MAX_SKB_FRAGS)
+		return false;
+
+	if (skb_vlan_tag_present(skb) != skb_vlan_tag_present(head) ||
+	    skb_vlan_tag_get(skb) != skb_vlan_tag_get(head) ||
+	    compare_ether_header(eth_hdr(skb), eth_hdr(head)))
+		return false;
+
+	if (skb->protocol == htons(ETH_P_IP)) {
+		const struct iphdr *iph = ip_hdr(skb);
+		const struct iphdr *iph0 = ip_hdr(head);
+
+		if (iph->saddr != iph0->saddr || iph->daddr != iph0->daddr ||
+		    iph->tos != iph0->tos || iph->ttl != iph0->ttl ||
+		    iph->frag_off != iph0->frag_off ||
+		    ntohs(iph->id) != (u16)(ntohs(iph0->id) + agg->segs))
+			return false;
+	} else {
+		const struct ipv6hdr *ip6h = ipv6_hdr(skb);
+		const struct ipv6hdr *ip6h0 = ipv6_hdr(head);
+
+		/* version, traffic class and flow label */
+		if (*(__be32 *)ip6h != *(__be32 *)ip6h0 ||
+		    ip6h->hop_limit != ip6h0->hop_limit ||
+		    !ipv6_addr_equal(&ip6h->saddr, &ip6h0->saddr) ||
+		    !ipv6_addr_equal(&ip6h->daddr, &ip6h0->daddr))
+			return false;
+	}
+
+	th = tcp_hdr(skb);
+	th0 = tcp_hdr(head);
+
+	/* same ports, in order, same ack, window and options, and no flag
+	 * changes other than PSH, which ends the aggregate
+	 */
+	return *(u32 *)th == *(u32 *)th0 &&
+	       ntohl(th->seq) == agg->next_seq &&
+	       th->ack_seq == th0->ack_seq &&
+	       !((tcp_flag_word(th) ^ tcp_flag_word(th0)) & ~TCP_FLAG_PSH) &&
+	       !memcmp(th + 1, th0 + 1, th->doff * 4 - sizeof(*th));
+}
+
+static void ionic_rx_agg_flush(struct ionic_queue *q)
+{
+	struct ionic_rx_agg *agg = &q->agg;
+	struct sk_buff *skb = agg->skb;
+	struct skb_shared_info *shinfo;
+	struct ionic_rx_stats *stats;
+	unsigned int tcplen;
+	struct tcphdr *th;
+
+	if (!skb)
+		return;
+	agg->skb = NULL;
+
+	if (agg->segs > 1) {
+		shinfo = skb_shinfo(skb);
+		th = tcp_hdr(skb);
+		tcplen = skb->len - agg->thoff;
+
+		/* make it look like the stack's own GRO output */
+		if (skb->protocol == htons(ETH_P_IP)) {
+			struct iphdr *iph = ip_hdr(skb);
+
+			iph->tot_len = htons(skb->len);
+			iph->check = 0;
+			iph->check = ip_fast_csum((u8 *)iph, iph->ihl);
+			th->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr,
+						       tcplen, IPPROTO_TCP, 0);
+			shinfo->gso_type = SKB_GSO_TCPV4;
+		} else {
+			struct ipv6hdr *ip6h = ipv6_hdr(skb);
+
+			ip6h->payload_len = htons(skb->len - sizeof(*ip6h));
+			th->check = ~csum_ipv6_magic(&ip6h->saddr, &ip6h->daddr,
+						     tcplen, IPPROTO_TCP, 0);
+			shinfo->gso_type = SKB_GSO_TCPV6;
+		}
+		shinfo->gso_size = agg->mss;
+		shinfo->gso_segs = agg->segs;
+
+		skb->ip_summed = CHECKSUM_PARTIAL;
+		skb->csum_start = skb_transport_header(skb) - skb->head;
+		skb->csum_offset = offsetof(struct tcphdr, check);
+
+		stats = q_to_rx_stats(q);
+		stats->gro_hw_pkts++;
+		stats->gro_hw_segs += agg->segs;
+	}
+
+	napi_gro_receive(&q_to_qcq(q)->napi, skb);
+}
+
+/* Fold skb into the aggregate held on the queue if it is the next
+ * segment of the same flow, otherwise flush that and start over with
+ * skb.  Whatever is held is flushed at the end of the poll.
+ */
+static void ionic_rx_agg(struct ionic_queue *q, struct sk_buff *skb,
+			 u8 csum_flags)
+{
+	struct ionic_rx_agg *agg = &q->agg;
+	struct skb_shared_info *shinfo;
+	unsigned int hlen, plen, thoff;
+	int delta_truesize;
+	struct tcphdr *th;
+	bool psh;
+
+	hlen = ionic_rx_agg_l3l4_len(skb->data, skb_headlen(skb),
+				     skb->protocol, &thoff);
+	if (!hlen || hlen != skb_headlen(skb))
+		goto deliver;
+
+	skb_reset_network_header(skb);
+	skb_set_transport_header(skb, thoff);
+	th = tcp_hdr(skb);
+
+	/* Ethernet padding would end up in the middle of the aggregate */
+	if (skb->protocol == htons(ETH_P_IP)) {
+		if (ntohs(ip_hdr(skb)->tot_len) != skb->len)
+			goto deliver;
+	} else if (ntohs(ipv6_hdr(skb)->payload_len) + sizeof(struct ipv6hdr) !=
+		   skb->len) {
+		goto deliver;
+	}
+
+	psh = th->psh;
+	plen = skb->len - hlen;
+	if (!plen || (tcp_flag_word(th) & IONIC_RX_AGG_TCP_FLAGS_BAD) ||
+	    !ionic_rx_agg_csum_ok(skb, csum_flags, thoff))
+		goto deliver;
+
+	if (agg->skb && ionic_rx_agg_match(agg, skb, hlen, plen)) {
+		struct sk_buff *head = agg->skb;
+
+		shinfo = skb_shinfo(skb);
+		memcpy(&skb_shinfo(head)->frags[skb_shinfo(head)->nr_frags],
+		       shinfo->frags, shinfo->nr_frags * sizeof(skb_frag_t));
+		skb_shinfo(head)->nr_frags += shinfo->nr_frags;
+
+		delta_truesize = skb->truesize - SKB_TRUESIZE(skb_end_offset(skb));
+		head->len += plen;
+		head->data_len += plen;
+		head->truesize += delta_truesize;
+
+		/* the frags belong to head now, free just the skb head */
+		shinfo->nr_frags = 0;
+		skb->len -= plen;
+		skb->data_len = 0;
+		skb->truesize -= delta_truesize;
+		napi_consume_skb(skb, 1);
+
+		agg->next_seq += plen;
+		agg->segs++;
+
+		if (psh || plen < agg->mss) {
+			tcp_hdr(head)->psh |= psh;
+			ionic_rx_agg_flush(q);
+		}
+		return;
+	}
+
+	ionic_rx_agg_flush(q);
+
+	if (psh) {
+		napi_gro_receive(&q_to_qcq(q)->napi, skb);
+		return;
+	}
+
+	agg->skb = skb;
+	agg->next_seq = ntohl(th->seq) + plen;
+	agg->thoff = thoff;
+	agg->hlen = hlen;
+	agg->mss = plen;
+	agg->segs = 1;
+	return;
+
+deliver:
+	ionic_rx_agg_flush(q);
+	napi_gro_receive(&q_to_qcq(q)->napi, skb);
+}
+#else
+static inline void ionic_rx_agg_flush(struct ionic_queue *q) {}
+#endif
+
+static void ionic_rx_clean(struct ionic_queue *q,
+			   struct ionic_desc_info *desc_info,
+			   struct ionic_cq_info *cq_info,
+			   void *cb_arg)
+{
+	struct net_device *netdev = q->lif->netdev;
+	struct ionic_qcq *qcq = q_to_qcq(q);
+	struct ionic_rx_stats *stats;
+	struct ionic_rxq_comp *comp;
+	struct sk_buff *skb;
+	unsigned int len;
+	bool agg = false;
+#ifdef CSUM_DEBUG
+	__sum16 csum;
+#endif
+
+	comp = cq_info->cq_desc + qcq->cq.desc_size - sizeof(*comp);
+
+	stats = q_to_rx_stats(q);
+
+	/* the packet ran past bufs[0], so the sg buffers will be used up */
+	len = le16_to_cpu(comp->len);
+	if (len > desc_info->head_len)
+		desc_info->sg_stale = true;
+
+	if (comp->status) {
+		stats->dropped++;
+		return;
+	}
+
+	if (len > netdev->mtu + ETH_HLEN + VLAN_HLEN) {
+		stats->dropped++;
+		net_warn_ratelimited("%s: RX PKT TOO LARGE! comp->len %d\n",
+				     netdev->name, len);
+		return;
+	}
+
+	stats->pkts++;
+	stats->bytes += len;
+
+	stats->size_hist[ionic_rx_size_bucket(len)]++;
+	if (unlikely(++q->copybreak.window >= IONIC_RX_CB_WINDOW))
+		ionic_rx_copybreak_adapt(q, stats);
+
+#ifdef IONIC_GRO_HW
+	agg = ionic_rx_agg_wanted(q, comp);
+#endif
+
+#ifdef IONIC_XSK
+	if (q->xsk_pool)
+		skb = ionic_xsk_rx_skb(q, desc_info, len);
+	else
+#endif
+		skb = ionic_rx_page_skb(q, desc_info, len, comp->num_sg_elems,
+					agg);
+	if (!skb)
 		return;
-	}
 
 #ifdef CSUM_DEBUG
 	csum = ip_compute_csum(skb->data, skb->len);
@@ -492,9 +2086,37 @@ static void ionic_rx_clean(struct ionic_queue *q,
 		}
 	}
 
+#ifdef IONIC_GRO_HW
+	if (agg) {
+		ionic_rx_agg(q, skb, comp->csum_flags);
+		return;
+	}
+#endif
+	/* keep the flow in order behind anything being aggregated */
+	ionic_rx_agg_flush(q);
+
 	napi_gro_receive(&qcq->napi, skb);
 }
 
+/* Warm up what the next few completions will touch: the completion
+ * entry a few slots out and the next buffer's page struct.  The packet
+ * bytes are left until after their dma sync, so a non-coherent platform
+ * can't pull in stale lines.
+ */
+static inline void ionic_rx_prefetch(struct ionic_queue *q,
+				     struct ionic_cq *cq)
+{
+	struct ionic_buf_info *buf_info;
+	unsigned int idx;
+
+	idx = (cq->tail_idx + IONIC_RX_PREFETCH_AHEAD) & (cq->num_descs - 1);
+	prefetch(cq->info[idx].cq_desc);
+
+	buf_info = &q->info[q->tail_idx].bufs[0];
+	if (buf_info->page)
+		prefetchw(buf_info->page);
+}
+
 bool ionic_rx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info)
 {
 	struct ionic_queue *q = cq->bound_q;
@@ -516,6 +2138,8 @@ bool ionic_rx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info)
 	desc_info = &q->info[q->tail_idx];
 	q->tail_idx = (q->tail_idx + 1) & (q->num_descs - 1);
 
+	ionic_rx_prefetch(q, cq);
+
 	/* clean the related q entry, only one per qc completion */
 	ionic_rx_clean(q, desc_info, cq_info, desc_info->cb_arg);
 
@@ -525,100 +2149,170 @@ bool ionic_rx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info)
 	return true;
 }
 
-void ionic_rx_fill(struct ionic_queue *q)
+/* Rx completions go through the common ionic_cq_service() loop, with
+ * the batch-level work done once the budget or the ring runs out.
+ */
+unsigned int ionic_rx_cq_service(struct ionic_cq *cq, unsigned int work_to_do)
+{
+	struct ionic_queue *q = cq->bound_q;
+	unsigned int work_done;
+
+	work_done = ionic_cq_service(cq, work_to_do, ionic_rx_service,
+				     NULL, NULL);
+
+	/* nothing is held over to the next poll */
+	ionic_rx_agg_flush(q);
+
+	/* feeds the adaptive fill threshold */
+	if (work_done)
+		q->comp_rate += work_done - (q->comp_rate >> 3);
+
+	return work_done;
+}
+
+/* Post buffers for one descriptor, returns false if we ran out of memory */
+static bool ionic_rx_fill_desc(struct ionic_queue *q,
+			       struct ionic_desc_info *desc_info,
+			       unsigned int len, unsigned int headroom)
 {
-	struct net_device *netdev = q->lif->netdev;
-	struct ionic_desc_info *desc_info;
 	struct ionic_rxq_sg_desc *sg_desc;
 	struct ionic_rxq_sg_elem *sg_elem;
 	struct ionic_buf_info *buf_info;
-	unsigned int fill_threshold;
 	struct ionic_rxq_desc *desc;
 	unsigned int remain_len;
+	unsigned int alloc_len;
 	unsigned int frag_len;
 	unsigned int nfrags;
-	unsigned int n_fill;
-	unsigned int len;
-	unsigned int i;
 	unsigned int j;
 
-	n_fill = ionic_q_space_avail(q);
+	nfrags = 0;
+	remain_len = len;
+	desc = desc_info->desc;
+	buf_info = &desc_info->bufs[0];
 
-	fill_threshold = min_t(unsigned int, rx_fill_threshold,
-			       q->num_descs / IONIC_RX_FILL_DIV);
-	if (n_fill < fill_threshold)
-		return;
+	if (!buf_info->page) { /* alloc a new buffer? */
+		if (q->hdr_split)
+			alloc_len = IONIC_RX_HDR_BUF_SZ;
+		else
+			alloc_len = ionic_rx_alloc_size(q, headroom + len);
+		if (unlikely(ionic_rx_page_alloc(q, buf_info, alloc_len))) {
+			desc->addr = 0;
+			desc->len = 0;
+			desc_info->sg_stale = true;
+			return false;
+		}
+	}
 
-	len = netdev->mtu + ETH_HLEN + VLAN_HLEN;
+	/* fill main descriptor - buf[0], leaving XDP its headroom,
+	 * or just the header when splitting
+	 */
+	if (q->hdr_split) {
+		desc->addr = cpu_to_le64(ionic_rx_buf_pa(buf_info) + NET_SKB_PAD);
+		frag_len = min_t(u16, len, IONIC_RX_HDR_SZ);
+	} else {
+		desc->addr = cpu_to_le64(ionic_rx_buf_pa(buf_info) + headroom);
+		frag_len = min_t(u16, len, ionic_rx_buf_size(buf_info) -
+					   headroom - ionic_rx_tailroom(q));
+	}
+	desc->len = cpu_to_le16(frag_len);
+	desc_info->head_len = frag_len;
+	remain_len -= frag_len;
+	buf_info++;
+	nfrags++;
 
-	for (i = n_fill; i; i--) {
-		nfrags = 0;
-		remain_len = len;
-		desc_info = &q->info[q->head_idx];
-		desc = desc_info->desc;
-		buf_info = &desc_info->bufs[0];
+	/* fill sg descriptors - buf[1..n]; if the last packet never
+	 * reached them, the sg buffers and the ring still hold the layout
+	 * we posted before, so there is nothing to walk or write
+	 */
+	if (!desc_info->sg_stale && remain_len == desc_info->sg_len) {
+		nfrags += desc_info->nbufs ? desc_info->nbufs - 1 : 0;
+		goto out;
+	}
 
-		if (!buf_info->page) { /* alloc a new buffer? */
-			if (unlikely(ionic_rx_page_alloc(q, buf_info))) {
-				desc->addr = 0;
-				desc->len = 0;
-				return;
+	desc_info->sg_stale = true;
+	desc_info->sg_len = remain_len;
+	sg_desc = desc_info->sg_desc;
+	for (j = 0; remain_len > 0 && j < q->max_sg_elems; j++) {
+		sg_elem = &sg_desc->elems[j];
+		if (!buf_info->page) { /* alloc a new sg buffer? */
+			alloc_len = ionic_rx_alloc_size(q, remain_len);
+			if (unlikely(ionic_rx_page_alloc(q, buf_info, alloc_len))) {
+				sg_elem->addr = 0;
+				sg_elem->len = 0;
+				return false;
 			}
 		}
 
-		/* fill main descriptor - buf[0] */
-		desc->addr = cpu_to_le64(ionic_rx_buf_pa(buf_info));
-		frag_len = min_t(u16, len, ionic_rx_buf_size(buf_info));
-		desc->len = cpu_to_le16(frag_len);
+		sg_elem->addr = cpu_to_le64(ionic_rx_buf_pa(buf_info));
+		frag_len = min_t(u16, remain_len, ionic_rx_buf_size(buf_info));
+		sg_elem->len = cpu_to_le16(frag_len);
 		remain_len -= frag_len;
 		buf_info++;
 		nfrags++;
+	}
 
-		/* fill sg descriptors - buf[1..n] */
-		sg_desc = desc_info->sg_desc;
-		for (j = 0; remain_len > 0 && j < q->max_sg_elems; j++) {
-			sg_elem = &sg_desc->elems[j];
-			if (!buf_info->page) { /* alloc a new sg buffer? */
-				if (unlikely(ionic_rx_page_alloc(q, buf_info))) {
-					sg_elem->addr = 0;
-					sg_elem->len = 0;
-					return;
-				}
-			}
+	/* clear end sg element as a sentinel */
+	if (j < q->max_sg_elems) {
+		sg_elem = &sg_desc->elems[j];
+		memset(sg_elem, 0, sizeof(*sg_elem));
+	}
+	desc_info->sg_stale = false;
 
-			sg_elem->addr = cpu_to_le64(ionic_rx_buf_pa(buf_info));
-			frag_len = min_t(u16, remain_len, ionic_rx_buf_size(buf_info));
-			sg_elem->len = cpu_to_le16(frag_len);
-			remain_len -= frag_len;
-			buf_info++;
-			nfrags++;
-		}
+out:
+	desc->opcode = (nfrags > 1) ? IONIC_RXQ_DESC_OPCODE_SG :
+					 IONIC_RXQ_DESC_OPCODE_SIMPLE;
+	desc_info->nbufs = nfrags;
 
-		/* clear end sg element as a sentinel */
-		if (j < q->max_sg_elems) {
-			sg_elem = &sg_desc->elems[j];
-			memset(sg_elem, 0, sizeof(*sg_elem));
-		}
+	return true;
+}
 
-		desc->opcode = (nfrags > 1) ? IONIC_RXQ_DESC_OPCODE_SG :
-						 IONIC_RXQ_DESC_OPCODE_SIMPLE;
-		desc_info->nbufs = nfrags;
+/* Wait for at least a couple of polls' worth of completions before
+ * refilling, so a busy queue posts big batches behind one doorbell,
+ * but never let more than 1/IONIC_RX_FILL_DIV of the ring run dry.
+ */
+static inline unsigned int ionic_rx_fill_threshold(struct ionic_queue *q)
+{
+	unsigned int hi = q->num_descs / IONIC_RX_FILL_DIV;
+	unsigned int lo = min_t(unsigned int, rx_fill_threshold, hi);
 
-		/* commit CMB descriptor contents in one shot */
-		if (q_to_qcq(q)->flags & IONIC_QCQ_F_CMB_RINGS)
-			memcpy_toio(desc_info->cmb_desc, desc, q->desc_size);
+	return clamp_t(unsigned int, (q->comp_rate >> 3) * 2, lo, hi);
+}
 
-		ionic_rxq_post(q, false, ionic_rx_clean, NULL);
+void ionic_rx_fill(struct ionic_queue *q)
+{
+	struct net_device *netdev = q->lif->netdev;
+	unsigned int headroom;
+	unsigned int n_fill;
+	unsigned int start;
+	unsigned int len;
+	unsigned int i;
+
+	n_fill = ionic_q_space_avail(q);
+
+	q->fill_threshold = ionic_rx_fill_threshold(q);
+	if (n_fill < q->fill_threshold)
+		return;
+
+#ifdef IONIC_XSK
+	if (q->xsk_pool) {
+		ionic_xsk_rx_fill(q, n_fill);
+		return;
 	}
+#endif
 
-	ionic_dbell_ring(q->lif->kern_dbpage, q->hw_type,
-			 q->dbval | q->head_idx);
+	len = netdev->mtu + ETH_HLEN + VLAN_HLEN;
+	headroom = ionic_rx_headroom(q);
+	start = q->head_idx;
 
-	q->dbell_deadline = IONIC_RX_MIN_DOORBELL_DEADLINE;
-	q->dbell_jiffies = jiffies;
+	for (i = n_fill; i; i--) {
+		if (unlikely(!ionic_rx_fill_desc(q, &q->info[q->head_idx],
+						 len, headroom)))
+			break;
+
+		ionic_rxq_post(q, false, ionic_rx_clean, NULL);
+	}
 
-	mod_timer(&q_to_qcq(q)->napi_qcq->napi_deadline,
-		  jiffies + IONIC_NAPI_DEADLINE);
+	ionic_rx_fill_commit(q, start);
 }
 
 void ionic_rx_empty(struct ionic_queue *q)
@@ -634,8 +2328,15 @@ void ionic_rx_empty(struct ionic_queue *q)
 			if (buf_info->page)
 				ionic_rx_page_free(q, buf_info);
 		}
+#ifdef IONIC_XSK
+		if (desc_info->xsk_buf) {
+			xsk_buff_free(desc_info->xsk_buf);
+			desc_info->xsk_buf = NULL;
+		}
+#endif
 
 		desc_info->nbufs = 0;
+		desc_info->sg_stale = true;
 		desc_info->cb = NULL;
 		desc_info->cb_arg = NULL;
 	}
@@ -643,7 +2344,9 @@ void ionic_rx_empty(struct ionic_queue *q)
 	q->head_idx = 0;
 	q->tail_idx = 0;
 
+#ifndef IONIC_PAGE_POOL
 	ionic_rx_cache_drain(q);
+#endif
 }
 
 static void ionic_dim_update(struct ionic_qcq *qcq, int napi_mode)
@@ -679,22 +2382,51 @@ static void ionic_dim_update(struct ionic_qcq *qcq, int napi_mode)
 
 	net_dim(&qcq->dim, dim_sample);
 }
+
+/* Count whether a busy-polling socket or the interrupt is driving this
+ * NAPI.  While busy polling, napi_complete_done() refuses to complete, as
+ * it does while napi_defer_hard_irqs holds the irq off, so the irq stays
+ * masked and the poller comes back on its own.
+ */
+static void ionic_napi_count_poll(struct napi_struct *napi, u64 *busy_polls,
+				  u64 *irq_polls)
+{
+#ifdef HAVE_NAPI_STATE_IN_BUSY_POLL
+	if (test_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state)) {
+		(*busy_polls)++;
+		return;
+	}
+#endif
+	(*irq_polls)++;
+}
+
 int ionic_tx_napi(struct napi_struct *napi, int budget)
 {
 	struct ionic_qcq *qcq = napi_to_qcq(napi);
 	struct ionic_cq *cq = napi_to_cq(napi);
+	struct ionic_tx_stats *stats;
 	struct ionic_dev *idev;
 	struct ionic_lif *lif;
+	bool xsk_busy = false;
 	u32 work_done = 0;
 	u32 flags = 0;
 
 	lif = cq->bound_q->lif;
 	idev = &lif->ionic->idev;
+	stats = q_to_tx_stats(cq->bound_q);
+	ionic_napi_count_poll(napi, &stats->busy_polls, &stats->irq_polls);
 
-	work_done = ionic_cq_service(cq, budget,
-				     ionic_tx_service, NULL, NULL);
+	work_done = ionic_tx_cq_service(cq, budget, budget);
 
-	if (work_done < budget && napi_complete_done(napi, work_done)) {
+	ionic_txq_dbell_flush(cq->bound_q);
+
+#ifdef IONIC_XSK
+	if (cq->bound_q->xsk_pool)
+		xsk_busy = !ionic_xsk_tx_xmit(cq->bound_q, budget);
+#endif
+
+	if (work_done < budget && !xsk_busy &&
+	    napi_complete_done(napi, work_done)) {
 		ionic_dim_update(qcq, IONIC_LIF_F_TX_DIM_INTR);
 		flags |= IONIC_INTR_CRED_UNMASK;
 		cq->bound_intr->rearm_count++;
@@ -707,18 +2439,39 @@ int ionic_tx_napi(struct napi_struct *napi, int budget)
 				   work_done, flags);
 	}
 
-	if (!work_done && ionic_txq_poke_doorbell(&qcq->q))
-		mod_timer(&qcq->napi_deadline, jiffies + IONIC_NAPI_DEADLINE);
+	if (!work_done)
+		ionic_txq_poke_doorbell(&qcq->q);
 
 	DEBUG_STATS_NAPI_POLL(qcq, work_done);
 
-	return work_done;
+	/* stay scheduled while the XSK TX ring has more for us */
+	return xsk_busy ? budget : work_done;
+}
+
+/* Follow the NAPI context to whichever node it is running on now, so
+ * that new rx buffers come from memory local to the CPU filling them
+ * and the stack consuming them.
+ */
+void ionic_rx_node_update(struct ionic_queue *q)
+{
+	int node = numa_mem_id();
+
+	if (likely(node == q->node))
+		return;
+
+	WRITE_ONCE(q->node, node);
+#ifdef IONIC_PAGE_POOL
+	if (q->page_pool)
+		page_pool_nid_changed(q->page_pool, node);
+#endif
+	q_to_rx_stats(q)->node_changes++;
 }
 
 int ionic_rx_napi(struct napi_struct *napi, int budget)
 {
 	struct ionic_qcq *qcq = napi_to_qcq(napi);
 	struct ionic_cq *cq = napi_to_cq(napi);
+	struct ionic_rx_stats *stats;
 	struct ionic_dev *idev;
 	struct ionic_lif *lif;
 	u32 work_done = 0;
@@ -726,9 +2479,14 @@ int ionic_rx_napi(struct napi_struct *napi, int budget)
 
 	lif = cq->bound_q->lif;
 	idev = &lif->ionic->idev;
+	stats = q_to_rx_stats(cq->bound_q);
+	ionic_napi_count_poll(napi, &stats->busy_polls, &stats->irq_polls);
+
+	ionic_rx_node_update(cq->bound_q);
 
-	work_done = ionic_cq_service(cq, budget,
-				     ionic_rx_service, NULL, NULL);
+	work_done = ionic_rx_cq_service(cq, budget);
+
+	ionic_xdp_rx_flush(cq->bound_q, budget);
 
 	ionic_rx_fill(cq->bound_q);
 
@@ -745,8 +2503,8 @@ int ionic_rx_napi(struct napi_struct *napi, int budget)
 				   work_done, flags);
 	}
 
-	if (!work_done && ionic_rxq_poke_doorbell(&qcq->q))
-		mod_timer(&qcq->napi_deadline, jiffies + IONIC_NAPI_DEADLINE);
+	if (!work_done)
+		ionic_rxq_poke_doorbell(&qcq->q);
 
 	DEBUG_STATS_NAPI_POLL(qcq, work_done);
 
@@ -761,8 +2519,9 @@ int ionic_txrx_napi(struct napi_struct *napi, int budget)
 	struct ionic_qcq *txqcq;
 	struct ionic_dev *idev;
 	struct ionic_lif *lif;
+	struct ionic_rx_stats *stats;
 	struct ionic_cq *txcq;
-	bool resched = false;
+	bool xsk_busy = false;
 	u32 rx_work_done = 0;
 	u32 tx_work_done = 0;
 	u32 flags = 0;
@@ -771,16 +2530,28 @@ int ionic_txrx_napi(struct napi_struct *napi, int budget)
 	idev = &lif->ionic->idev;
 	txqcq = lif->txqcqs[qi];
 	txcq = &lif->txqcqs[qi]->cq;
+	stats = q_to_rx_stats(rxcq->bound_q);
+	ionic_napi_count_poll(napi, &stats->busy_polls, &stats->irq_polls);
 
-	tx_work_done = ionic_cq_service(txcq, tx_budget,
-					ionic_tx_service, NULL, NULL);
+	tx_work_done = ionic_tx_cq_service(txcq, tx_budget, budget);
 
-	rx_work_done = ionic_cq_service(rxcq, budget,
-					ionic_rx_service, NULL, NULL);
+	ionic_txq_dbell_flush(&txqcq->q);
+
+#ifdef IONIC_XSK
+	if (txqcq->q.xsk_pool)
+		xsk_busy = !ionic_xsk_tx_xmit(&txqcq->q, tx_budget);
+#endif
+
+	ionic_rx_node_update(rxcq->bound_q);
+
+	rx_work_done = ionic_rx_cq_service(rxcq, budget);
+
+	ionic_xdp_rx_flush(rxcq->bound_q, budget);
 
 	ionic_rx_fill(rxcq->bound_q);
 
-	if (rx_work_done < budget && napi_complete_done(napi, rx_work_done)) {
+	if (rx_work_done < budget && !xsk_busy &&
+	    napi_complete_done(napi, rx_work_done)) {
 		ionic_dim_update(rxqcq, 0);
 		flags |= IONIC_INTR_CRED_UNMASK;
 		rxcq->bound_intr->rearm_count++;
@@ -795,14 +2566,13 @@ int ionic_txrx_napi(struct napi_struct *napi, int budget)
 	DEBUG_STATS_NAPI_POLL(rxqcq, rx_work_done);
 	DEBUG_STATS_NAPI_POLL(txqcq, tx_work_done);
 
-	if (!rx_work_done && ionic_rxq_poke_doorbell(&rxqcq->q))
-		resched = true;
-	if (!tx_work_done && ionic_txq_poke_doorbell(&txqcq->q))
-		resched = true;
-	if (resched)
-		mod_timer(&rxqcq->napi_deadline, jiffies + IONIC_NAPI_DEADLINE);
+	if (!rx_work_done)
+		ionic_rxq_poke_doorbell(&rxqcq->q);
+	if (!tx_work_done)
+		ionic_txq_poke_doorbell(&txqcq->q);
 
-	return rx_work_done;
+	/* stay scheduled while the XSK TX ring has more for us */
+	return xsk_busy ? budget : rx_work_done;
 }
 
 static dma_addr_t ionic_tx_map_single(struct ionic_queue *q,
@@ -839,8 +2609,37 @@ static dma_addr_t ionic_tx_map_frag(struct ionic_queue *q,
 	return dma_addr;
 }
 
+/* Copy a small head into this descriptor's premapped slot so that it
+ * costs a sync rather than an IOMMU map and unmap.  As with the CMB
+ * slots, a slot is only reused once its previous owner has completed.
+ */
+static bool ionic_tx_bounce_head(struct ionic_queue *q, struct sk_buff *skb,
+				 struct ionic_desc_info *desc_info)
+{
+	struct ionic_buf_info *buf_info = desc_info->bufs;
+	struct ionic_qcq *qcq = q_to_qcq(q);
+	unsigned int len = skb_headlen(skb);
+	unsigned int offset;
+
+	if (len > IONIC_TX_BOUNCE_SZ ||
+	    ((q->head_idx - q->tail_idx) & (q->num_descs - 1)) >=
+	    qcq->tx_bounce_slots)
+		return false;
+
+	offset = (q->head_idx & (qcq->tx_bounce_slots - 1)) * IONIC_TX_BOUNCE_SZ;
+	memcpy(qcq->tx_bounce_base + offset, skb->data, len);
+	dma_sync_single_range_for_device(q->dev, qcq->tx_bounce_dma, offset,
+					 len, DMA_TO_DEVICE);
+
+	buf_info->dma_addr = qcq->tx_bounce_dma + offset;
+	buf_info->len = len;
+	desc_info->bounce = true;
+
+	return true;
+}
+
 static int ionic_tx_map_skb(struct ionic_queue *q, struct sk_buff *skb,
-			    struct ionic_desc_info *desc_info)
+			    struct ionic_desc_info *desc_info, bool bounce)
 {
 	struct ionic_buf_info *buf_info = desc_info->bufs;
 	struct ionic_tx_stats *stats = q_to_tx_stats(q);
@@ -850,17 +2649,29 @@ static int ionic_tx_map_skb(struct ionic_queue *q, struct sk_buff *skb,
 	skb_frag_t *frag;
 	int frag_idx;
 
-	dma_addr = ionic_tx_map_single(q, skb->data, skb_headlen(skb));
-	if (dma_mapping_error(dev, dma_addr)) {
-		stats->dma_map_err++;
-		return -EIO;
+	desc_info->bounce = false;
+	nfrags = skb_shinfo(skb)->nr_frags;
+
+	if (q_to_qcq(q)->tx_bounce_slots) {
+		if (bounce && ionic_tx_bounce_head(q, skb, desc_info))
+			stats->bounce_hit++;
+		else
+			stats->bounce_miss++;
+		stats->bounce_miss += nfrags;
+	}
+
+	if (!desc_info->bounce) {
+		dma_addr = ionic_tx_map_single(q, skb->data, skb_headlen(skb));
+		if (dma_mapping_error(dev, dma_addr)) {
+			stats->dma_map_err++;
+			return -EIO;
+		}
+		buf_info->dma_addr = dma_addr;
+		buf_info->len = skb_headlen(skb);
 	}
-	buf_info->dma_addr = dma_addr;
-	buf_info->len = skb_headlen(skb);
 	buf_info++;
 
 	frag = skb_shinfo(skb)->frags;
-	nfrags = skb_shinfo(skb)->nr_frags;
 	for (frag_idx = 0; frag_idx < nfrags; frag_idx++, frag++) {
 		dma_addr = ionic_tx_map_frag(q, frag, 0, skb_frag_size(frag));
 		if (dma_mapping_error(dev, dma_addr)) {
@@ -884,7 +2695,10 @@ dma_fail:
 		dma_unmap_page(dev, buf_info->dma_addr,
 			       buf_info->len, DMA_TO_DEVICE);
 	}
-	dma_unmap_single(dev, buf_info->dma_addr, buf_info->len, DMA_TO_DEVICE);
+	if (!desc_info->bounce)
+		dma_unmap_single(dev, buf_info->dma_addr, buf_info->len,
+				 DMA_TO_DEVICE);
+	desc_info->bounce = false;
 	return -EIO;
 }
 
@@ -898,8 +2712,10 @@ static void ionic_tx_desc_unmap_bufs(struct ionic_queue *q,
 	if (!desc_info->nbufs)
 		return;
 
-	dma_unmap_single(dev, (dma_addr_t)buf_info->dma_addr,
-			 buf_info->len, DMA_TO_DEVICE);
+	if (!desc_info->bounce)
+		dma_unmap_single(dev, (dma_addr_t)buf_info->dma_addr,
+				 buf_info->len, DMA_TO_DEVICE);
+	desc_info->bounce = false;
 	buf_info++;
 	for (i = 1; i < desc_info->nbufs; i++, buf_info++)
 		dma_unmap_page(dev, (dma_addr_t)buf_info->dma_addr,
@@ -908,10 +2724,11 @@ static void ionic_tx_desc_unmap_bufs(struct ionic_queue *q,
 	desc_info->nbufs = 0;
 }
 
-static void ionic_tx_clean(struct ionic_queue *q,
-			   struct ionic_desc_info *desc_info,
-			   struct ionic_cq_info *cq_info,
-			   void *cb_arg)
+/* budget is the NAPI budget, or 0 outside of NAPI context */
+static void __ionic_tx_clean(struct ionic_queue *q,
+			     struct ionic_desc_info *desc_info,
+			     struct ionic_cq_info *cq_info,
+			     void *cb_arg, int budget)
 {
 	struct ionic_tx_stats *stats = q_to_tx_stats(q);
 	struct ionic_qcq *qcq = q_to_qcq(q);
@@ -920,6 +2737,33 @@ static void ionic_tx_clean(struct ionic_queue *q,
 
 	ionic_tx_desc_unmap_bufs(q, desc_info);
 
+#ifdef IONIC_XSK
+	if (desc_info->xsk_tx) {
+		/* reported to the pool in batches by ionic_xsk_tx_xmit() */
+		desc_info->xsk_tx = false;
+		q->xsk_tx_done++;
+		stats->clean++;
+		return;
+	}
+#endif
+#ifdef IONIC_XDP
+	if (desc_info->xdpf) {
+		xdp_return_frame(desc_info->xdpf);
+		desc_info->xdpf = NULL;
+		stats->clean++;
+
+		/* xdp txqs have no netdev subqueue behind them */
+		if (qcq->flags & IONIC_QCQ_F_XDP)
+			return;
+
+		if (unlikely(__netif_subqueue_stopped(q->lif->netdev, q->index))) {
+			netif_wake_subqueue(q->lif->netdev, q->index);
+			q->wake++;
+		}
+		return;
+	}
+#endif
+
 	if (!skb)
 		return;
 
@@ -959,16 +2803,25 @@ static void ionic_tx_clean(struct ionic_queue *q,
 	desc_info->bytes = skb->len;
 	stats->clean++;
 
-	dev_consume_skb_any(skb);
+	/* bulk returned to the slab when called with a NAPI budget */
+	napi_consume_skb(skb, budget);
+}
+
+static void ionic_tx_clean(struct ionic_queue *q,
+			   struct ionic_desc_info *desc_info,
+			   struct ionic_cq_info *cq_info,
+			   void *cb_arg)
+{
+	__ionic_tx_clean(q, desc_info, cq_info, cb_arg, 0);
 }
 
-bool ionic_tx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info)
+static bool ionic_tx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info,
+			     unsigned int *pkts, unsigned int *bytes,
+			     int budget)
 {
 	struct ionic_queue *q = cq->bound_q;
 	struct ionic_desc_info *desc_info;
 	struct ionic_txq_comp *comp;
-	int bytes = 0;
-	int pkts = 0;
 	u16 index;
 
 	comp = cq_info->cq_desc + cq->desc_size - sizeof(*comp);
@@ -984,21 +2837,60 @@ bool ionic_tx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info)
 		desc_info->bytes = 0;
 		index = q->tail_idx;
 		q->tail_idx = (q->tail_idx + 1) & (q->num_descs - 1);
-		ionic_tx_clean(q, desc_info, cq_info, desc_info->cb_arg);
+		__ionic_tx_clean(q, desc_info, cq_info, desc_info->cb_arg,
+				 budget);
 		if (desc_info->cb_arg) {
-			pkts++;
-			bytes += desc_info->bytes;
+			(*pkts)++;
+			*bytes += desc_info->bytes;
 		}
 		desc_info->cb = NULL;
 		desc_info->cb_arg = NULL;
 	} while (index != le16_to_cpu(comp->comp_index));
 
+	return true;
+}
+
+/* The Tx flavor of ionic_cq_service(): completions are gathered over
+ * the whole poll so that BQL is told once, and the skbs are handed to
+ * napi_consume_skb() with the NAPI budget so they are freed in bulk.
+ */
+unsigned int ionic_tx_cq_service(struct ionic_cq *cq, unsigned int work_to_do,
+				 int budget)
+{
+	struct ionic_cq_info *cq_info;
+	unsigned int work_done = 0;
+	unsigned int bytes = 0;
+	unsigned int pkts = 0;
+#ifdef IONIC_DEBUG_STATS
+	cycles_t t0 = get_cycles();
+#endif
+
+	if (work_to_do == 0)
+		return 0;
+
+	cq_info = &cq->info[cq->tail_idx];
+	while (ionic_tx_service(cq, cq_info, &pkts, &bytes, budget)) {
+		if (cq->tail_idx == cq->num_descs - 1)
+			cq->done_color = !cq->done_color;
+		cq->tail_idx = (cq->tail_idx + 1) & (cq->num_descs - 1);
+		cq_info = &cq->info[cq->tail_idx];
+		DEBUG_STATS_CQE_CNT(cq);
+
+		if (++work_done >= work_to_do)
+			break;
+	}
+
 #ifdef IONIC_SUPPORTS_BQL
-	if (pkts && bytes && !unlikely(q->features & IONIC_TXQ_F_HWSTAMP))
-		netdev_tx_completed_queue(q_to_ndq(q), pkts, bytes);
+	if (pkts && bytes && !unlikely(cq->bound_q->features & IONIC_TXQ_F_HWSTAMP))
+		netdev_tx_completed_queue(q_to_ndq(cq->bound_q), pkts, bytes);
 #endif
 
-	return true;
+#ifdef IONIC_DEBUG_STATS
+	if (work_done)
+		q_to_tx_stats(cq->bound_q)->clean_cycles += get_cycles() - t0;
+#endif
+
+	return work_done;
 }
 
 void ionic_tx_flush(struct ionic_cq *cq)
@@ -1006,10 +2898,10 @@ void ionic_tx_flush(struct ionic_cq *cq)
 	struct ionic_dev *idev = &cq->lif->ionic->idev;
 	u32 work_done;
 
-	work_done = ionic_cq_service(cq, cq->num_descs,
-				     ionic_tx_service, NULL, NULL);
+	work_done = ionic_tx_cq_service(cq, cq->num_descs, 0);
 
-	if (work_done)
+	if (work_done &&
+	    cq->bound_intr->index != IONIC_INTR_INDEX_NOT_ASSIGNED)
 		ionic_intr_credits(idev->intr_ctrl, cq->bound_intr->index,
 				   work_done, IONIC_INTR_CRED_RESET_COALESCE);
 }
@@ -1034,6 +2926,13 @@ void ionic_tx_empty(struct ionic_queue *q)
 		desc_info->cb_arg = NULL;
 	}
 
+#ifdef IONIC_XSK
+	if (q->xsk_pool && q->xsk_tx_done) {
+		xsk_tx_completed(q->xsk_pool, q->xsk_tx_done);
+		q->xsk_tx_done = 0;
+	}
+#endif
+
 #ifdef IONIC_SUPPORTS_BQL
 	if (pkts && bytes && !unlikely(q->features & IONIC_TXQ_F_HWSTAMP))
 		netdev_tx_completed_queue(q_to_ndq(q), pkts, bytes);
@@ -1088,45 +2987,25 @@ static int ionic_tx_tcp_pseudo_csum(struct sk_buff *skb)
 	return 0;
 }
 
-static void ionic_tx_tso_post(struct ionic_queue *q,
-			      struct ionic_desc_info *desc_info,
-			      struct sk_buff *skb,
-			      dma_addr_t addr, u8 nsge, u16 len,
-			      unsigned int hdrlen, unsigned int mss,
-			      bool outer_csum,
-			      u16 vlan_tci, bool has_vlan,
-			      bool start, bool done)
+/* Copy the host descriptors first..last into the CMB ring, in at most
+ * two writes when the range wraps the ring.
+ */
+static void ionic_tx_cmb_copy(struct ionic_queue *q,
+			      unsigned int first, unsigned int last)
 {
-	struct ionic_txq_desc *desc = desc_info->desc;
-	u8 flags = 0;
-	u64 cmd;
-
-	flags |= has_vlan ? IONIC_TXQ_DESC_FLAG_VLAN : 0;
-	flags |= outer_csum ? IONIC_TXQ_DESC_FLAG_ENCAP : 0;
-	flags |= start ? IONIC_TXQ_DESC_FLAG_TSO_SOT : 0;
-	flags |= done ? IONIC_TXQ_DESC_FLAG_TSO_EOT : 0;
-
-	cmd = encode_txq_desc_cmd(IONIC_TXQ_DESC_OPCODE_TSO, flags, nsge, addr);
-	desc->cmd = cpu_to_le64(cmd);
-	desc->len = cpu_to_le16(len);
-	desc->vlan_tci = cpu_to_le16(vlan_tci);
-	desc->hdr_len = cpu_to_le16(hdrlen);
-	desc->mss = cpu_to_le16(mss);
-
-	/* commit CMB descriptor contents in one shot */
-	if (q_to_qcq(q)->flags & IONIC_QCQ_F_CMB_RINGS)
-		memcpy_toio(desc_info->cmb_desc, desc, q->desc_size);
-
-	if (start) {
-		skb_tx_timestamp(skb);
-#ifdef IONIC_SUPPORTS_BQL
-		if (!unlikely(q->features & IONIC_TXQ_F_HWSTAMP))
-			netdev_tx_sent_queue(q_to_ndq(q), skb->len);
-#endif
-		ionic_txq_post(q, false, ionic_tx_clean, skb);
-	} else {
-		ionic_txq_post(q, done, NULL, NULL);
+	struct ionic_desc_info *desc_info = &q->info[first];
+	unsigned int n;
+
+	if (last < first) {
+		n = q->num_descs - first;
+		memcpy_toio(desc_info->cmb_desc, desc_info->desc,
+			    n * q->desc_size);
+		desc_info = &q->info[0];
+		first = 0;
 	}
+
+	n = last - first + 1;
+	memcpy_toio(desc_info->cmb_desc, desc_info->desc, n * q->desc_size);
 }
 
 static int ionic_tx_tso(struct ionic_queue *q, struct sk_buff *skb)
@@ -1135,14 +3014,17 @@ static int ionic_tx_tso(struct ionic_queue *q, struct sk_buff *skb)
 	struct ionic_desc_info *desc_info;
 	struct ionic_buf_info *buf_info;
 	struct ionic_txq_sg_elem *elem;
+	struct ionic_txq_desc tmpl;
 	struct ionic_txq_desc *desc;
 	unsigned int chunk_len;
 	unsigned int frag_rem;
 	unsigned int tso_rem;
 	unsigned int seg_rem;
+	unsigned int first;
 	dma_addr_t desc_addr;
 	dma_addr_t frag_addr;
 	unsigned int hdrlen;
+	unsigned int segs;
 	unsigned int len;
 	unsigned int mss;
 	bool start, done;
@@ -1150,14 +3032,18 @@ static int ionic_tx_tso(struct ionic_queue *q, struct sk_buff *skb)
 	bool has_vlan;
 	u16 desc_len;
 	u8 desc_nsge;
-	u16 vlan_tci;
 	bool encap;
+	u8 flags;
+	u64 cmd;
 	int err;
+#ifdef IONIC_DEBUG_STATS
+	cycles_t t0 = get_cycles();
+#endif
 
 	desc_info = &q->info[q->head_idx];
 	buf_info = desc_info->bufs;
 
-	if (unlikely(ionic_tx_map_skb(q, skb, desc_info)))
+	if (unlikely(ionic_tx_map_skb(q, skb, desc_info, false)))
 		return -EIO;
 
 	len = skb->len;
@@ -1179,7 +3065,6 @@ static int ionic_tx_tso(struct ionic_queue *q, struct sk_buff *skb)
 						   SKB_GSO_UDP_TUNNEL |
 						   SKB_GSO_UDP_TUNNEL_CSUM));
 	has_vlan = !!skb_vlan_tag_present(skb);
-	vlan_tci = skb_vlan_tag_get(skb);
 	encap = skb->encapsulation;
 
 	/* Preload inner-most TCP csum field with IP pseudo hdr
@@ -1202,13 +3087,32 @@ static int ionic_tx_tso(struct ionic_queue *q, struct sk_buff *skb)
 	else
 		hdrlen = skb_tcp_all_headers(skb);
 
+	/* Everything but cmd and len is the same for every segment, so
+	 * build it once and stamp it per descriptor.
+	 */
+	flags = has_vlan ? IONIC_TXQ_DESC_FLAG_VLAN : 0;
+	flags |= outer_csum ? IONIC_TXQ_DESC_FLAG_ENCAP : 0;
+	tmpl.cmd = 0;
+	tmpl.len = 0;
+	tmpl.vlan_tci = cpu_to_le16(skb_vlan_tag_get(skb));
+	tmpl.hdr_len = cpu_to_le16(hdrlen);
+	tmpl.mss = cpu_to_le16(mss);
+
+	skb_tx_timestamp(skb);
+#ifdef IONIC_SUPPORTS_BQL
+	if (!unlikely(q->features & IONIC_TXQ_F_HWSTAMP))
+		netdev_tx_sent_queue(q_to_ndq(q), skb->len);
+#endif
+
 	tso_rem = len;
 	seg_rem = min(tso_rem, hdrlen + mss);
 
 	frag_addr = 0;
 	frag_rem = 0;
 
+	first = q->head_idx;
 	start = true;
+	segs = 0;
 
 	while (tso_rem > 0) {
 		desc = NULL;
@@ -1246,11 +3150,28 @@ static int ionic_tx_tso(struct ionic_queue *q, struct sk_buff *skb)
 		}
 		seg_rem = min(tso_rem, mss);
 		done = (tso_rem == 0);
+
+		*desc = tmpl;
+		cmd = encode_txq_desc_cmd(IONIC_TXQ_DESC_OPCODE_TSO,
+					  flags |
+					  (start ? IONIC_TXQ_DESC_FLAG_TSO_SOT : 0) |
+					  (done ? IONIC_TXQ_DESC_FLAG_TSO_EOT : 0),
+					  desc_nsge, desc_addr);
+		desc->cmd = cpu_to_le64(cmd);
+		desc->len = cpu_to_le16(desc_len);
+		segs++;
+
+		/* the CMB ring gets the whole burst before the doorbell */
+		if (done && (q_to_qcq(q)->flags & IONIC_QCQ_F_CMB_RINGS))
+			ionic_tx_cmb_copy(q, first, q->head_idx);
+
 		/* post descriptor */
-		ionic_tx_tso_post(q, desc_info, skb,
-				  desc_addr, desc_nsge, desc_len,
-				  hdrlen, mss, outer_csum, vlan_tci, has_vlan,
-				  start, done);
+		if (start)
+			ionic_txq_post(q, done && !ionic_txq_dbell_defer(q),
+				       ionic_tx_clean, skb);
+		else
+			ionic_txq_post(q, done && !ionic_txq_dbell_defer(q),
+				       NULL, NULL);
 		start = false;
 		/* Buffer information is stored with the first tso descriptor */
 		desc_info = &q->info[q->head_idx];
@@ -1260,7 +3181,11 @@ static int ionic_tx_tso(struct ionic_queue *q, struct sk_buff *skb)
 	stats->pkts += DIV_ROUND_UP(len - hdrlen, mss);
 	stats->bytes += len;
 	stats->tso++;
-	stats->tso_bytes = len;
+	stats->tso_bytes += len;
+	stats->tso_segs += segs;
+#ifdef IONIC_DEBUG_STATS
+	stats->tso_cycles += get_cycles() - t0;
+#endif
 
 	return 0;
 }
@@ -1380,7 +3305,7 @@ static int ionic_tx(struct ionic_queue *q, struct sk_buff *skb)
 	struct ionic_desc_info *desc_info = &q->info[q->head_idx];
 	struct ionic_tx_stats *stats = q_to_tx_stats(q);
 
-	if (unlikely(ionic_tx_map_skb(q, skb, desc_info)))
+	if (unlikely(ionic_tx_map_skb(q, skb, desc_info, true)))
 		return -EIO;
 
 	/* set up the initial descriptor */
@@ -1400,11 +3325,75 @@ static int ionic_tx(struct ionic_queue *q, struct sk_buff *skb)
 	if (!unlikely(q->features & IONIC_TXQ_F_HWSTAMP))
 		netdev_tx_sent_queue(q_to_ndq(q), skb->len);
 #endif
-#ifdef HAVE_SKB_XMIT_MORE
-	ionic_txq_post(q, !netdev_xmit_more(), ionic_tx_clean, skb);
-#else
-	ionic_txq_post(q, true, ionic_tx_clean, skb);
-#endif
+	ionic_txq_post(q, !ionic_txq_dbell_defer(q), ionic_tx_clean, skb);
+
+	return 0;
+}
+
+/* A non-TSO frame has to fit in one descriptor, so instead of
+ * linearizing the whole skb, copy only the cheapest run of adjacent
+ * frags that brings it down to max_sg_elems into a fresh page, and
+ * leave the rest of the frags to be mapped in place.
+ */
+static int ionic_tx_frags_pack(struct ionic_queue *q, struct sk_buff *skb)
+{
+	struct ionic_tx_stats *stats = q_to_tx_stats(q);
+	unsigned int nfrags = skb_shinfo(skb)->nr_frags;
+	unsigned int run = nfrags - q->max_sg_elems + 1;
+	unsigned int best_len, best = 0;
+	unsigned int len, offset, i;
+	struct page *page;
+	int order;
+
+	len = 0;
+	for (i = 0; i < run; i++)
+		len += skb_frag_size(&skb_shinfo(skb)->frags[i]);
+	best_len = len;
+	for (i = run; i < nfrags; i++) {
+		len += skb_frag_size(&skb_shinfo(skb)->frags[i]);
+		len -= skb_frag_size(&skb_shinfo(skb)->frags[i - run]);
+		if (len < best_len) {
+			best_len = len;
+			best = i - run + 1;
+		}
+	}
+
+	if (best_len > IONIC_TX_FRAG_PACK_MAX)
+		return -E2BIG;
+
+	/* the frag array is about to change, it can't be shared */
+	if (skb_unclone(skb, GFP_ATOMIC))
+		return -ENOMEM;
+
+	order = get_order(best_len);
+	page = alloc_pages(GFP_ATOMIC | __GFP_NOWARN | __GFP_COMP, order);
+	if (!page)
+		return -ENOMEM;
+
+	offset = skb_headlen(skb);
+	for (i = 0; i < best; i++)
+		offset += skb_frag_size(&skb_shinfo(skb)->frags[i]);
+	if (skb_copy_bits(skb, offset, page_address(page), best_len)) {
+		__free_pages(page, order);
+		return -EFAULT;
+	}
+
+	for (i = best; i < best + run; i++)
+		skb_frag_unref(skb, i);
+	memmove(&skb_shinfo(skb)->frags[best + 1],
+		&skb_shinfo(skb)->frags[best + run],
+		(nfrags - best - run) * sizeof(skb_frag_t));
+	__skb_fill_page_desc(skb, best, page, 0, best_len);
+	skb_shinfo(skb)->nr_frags = nfrags - run + 1;
+	/* like pskb_expand_head(), leave truesize alone once a socket
+	 * has been charged for it
+	 */
+	if (!skb->sk)
+		skb->truesize += PAGE_SIZE << order;
+
+	stats->frag_pack++;
+	stats->frag_copy_bytes += best_len;
+	stats->frag_zc_bytes += skb->data_len - best_len;
 
 	return 0;
 }
@@ -1412,6 +3401,7 @@ static int ionic_tx(struct ionic_queue *q, struct sk_buff *skb)
 static int ionic_tx_descs_needed(struct ionic_queue *q, struct sk_buff *skb)
 {
 	struct ionic_tx_stats *stats = q_to_tx_stats(q);
+	unsigned int data_len;
 	int ndescs;
 	int err;
 
@@ -1425,12 +3415,17 @@ static int ionic_tx_descs_needed(struct ionic_queue *q, struct sk_buff *skb)
 	if (skb_shinfo(skb)->nr_frags <= q->max_sg_elems)
 		return ndescs;
 
+	if (!skb_is_gso(skb) && !ionic_tx_frags_pack(q, skb))
+		return ndescs;
+
 	/* Too many frags, so linearize */
+	data_len = skb->data_len;
 	err = skb_linearize(skb);
 	if (err)
 		return err;
 
 	stats->linearize++;
+	stats->frag_copy_bytes += data_len;
 
 	return ndescs;
 }
@@ -1457,16 +3452,24 @@ static int ionic_maybe_stop_tx(struct ionic_queue *q, int ndescs)
 
 #if IS_ENABLED(CONFIG_PTP_1588_CLOCK)
 static netdev_tx_t ionic_start_hwstamp_xmit(struct sk_buff *skb,
-					    struct net_device *netdev)
+					    struct net_device *netdev,
+					    unsigned int nqs)
 {
 	struct ionic_lif *lif = netdev_priv(netdev);
-	struct ionic_queue *q = &lif->hwstamp_txq->q;
+	struct ionic_queue *q;
 	int err, ndescs;
 
+	/* The flow hash keeps each PTP flow on one hwstamp txq, in order,
+	 * while different flows from different cores spread over the pool.
+	 */
+	q = &lif->hwstamp_txqs[skb_get_hash(skb) % nqs]->q;
+
 	/* Does not stop/start txq, because we post to a separate tx queue
 	 * for timestamping, and if a packet can't be posted immediately to
-	 * the timestamping queue, it is dropped.
+	 * the timestamping queue, it is dropped.  Any CPU may post here,
+	 * whichever stack txq the skb was mapped to.
 	 */
+	spin_lock(&q->hwstamp_lock);
 
 	ndescs = ionic_tx_descs_needed(q, skb);
 	if (unlikely(ndescs < 0))
@@ -1484,10 +3487,14 @@ static netdev_tx_t ionic_start_hwstamp_xmit(struct sk_buff *skb,
 	if (err)
 		goto err_out_drop;
 
+	spin_unlock(&q->hwstamp_lock);
+
 	return NETDEV_TX_OK;
 
 err_out_drop:
 	q->drop++;
+	q_to_tx_stats(q)->hwstamp_drop++;
+	spin_unlock(&q->hwstamp_lock);
 	dev_kfree_skb(skb);
 	return NETDEV_TX_OK;
 }
@@ -1507,9 +3514,12 @@ netdev_tx_t ionic_start_xmit(struct sk_buff *skb, struct net_device *netdev)
 	}
 
 #if IS_ENABLED(CONFIG_PTP_1588_CLOCK)
-	if (unlikely(skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP))
-		if (lif->hwstamp_txq && lif->phc->ts_config_tx_mode)
-			return ionic_start_hwstamp_xmit(skb, netdev);
+	if (unlikely(skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP)) {
+		unsigned int nqs = READ_ONCE(lif->nhwstamp_txqs);
+
+		if (nqs && lif->phc->ts_config_tx_mode)
+			return ionic_start_hwstamp_xmit(skb, netdev, nqs);
+	}
 #endif
 
 	if (unlikely(queue_index >= lif->nxqs))
@@ -14,8 +14,19 @@ int ionic_rx_napi(struct napi_struct *napi, int budget);
 int ionic_tx_napi(struct napi_struct *napi, int budget);
 int ionic_txrx_napi(struct napi_struct *napi, int budget);
 netdev_tx_t ionic_start_xmit(struct sk_buff *skb, struct net_device *netdev);
+#ifdef IONIC_XDP
+int ionic_xdp_xmit(struct net_device *netdev, int n,
+		   struct xdp_frame **xdp_frames, u32 flags);
+void ionic_xdp_txq_service(struct ionic_queue *q);
+#endif
+#ifdef IONIC_XSK
+int ionic_xsk_wakeup(struct net_device *netdev, u32 qid, u32 flags);
+#endif
 
+void ionic_rx_node_update(struct ionic_queue *q);
 bool ionic_rx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info);
-bool ionic_tx_service(struct ionic_cq *cq, struct ionic_cq_info *cq_info);
+unsigned int ionic_rx_cq_service(struct ionic_cq *cq, unsigned int work_to_do);
+unsigned int ionic_tx_cq_service(struct ionic_cq *cq, unsigned int work_to_do,
+				 int budget);
 
 #endif /* _IONIC_TXRX_H_ */
@@ -6459,6 +6459,7 @@ enum devlink_port_flavour {
 #define HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS
 #define NO_NDO_XDP_FLUSH
 #define HAVE_AF_XDP_SUPPORT
+#define HAVE_NETDEV_XPS_CPUS_MAP
 #endif /* 4.18.0 */
 
 /*****************************************************************************/
@@ -6753,6 +6754,9 @@ static inline bool dev_page_is_reusable(struct page *page)
 		      !page_is_pfmemalloc(page));
 }
 #endif
+#else
+#define HAVE_DEV_SET_THREADED
+#define HAVE_NETDEV_XPS_MAPS
 #endif /* 5.12.0 */
 
 /*****************************************************************************/
@@ -6760,6 +6764,8 @@ static inline bool dev_page_is_reusable(struct page *page)
 
 void _kc_ethtool_sprintf(u8 **data, const char *fmt, ...);
 #define ethtool_sprintf _kc_ethtool_sprintf
+#else
+#define HAVE_ALLOC_PAGES_BULK
 #endif /* 5.13.0 */
 
 /*****************************************************************************/
@@ -6860,8 +6866,33 @@ static inline int skb_inner_tcp_all_headers(const struct sk_buff *skb)
 #if (KERNEL_VERSION(6, 3, 0) > LINUX_VERSION_CODE)
 #else
 #define HAVE_RX_PUSH
+#define HAVE_XDP_FEATURES
 #endif /* 6.3 */
 
+/*****************************************************************************/
+#if (KERNEL_VERSION(6, 6, 0) > LINUX_VERSION_CODE)
+#else
+#define HAVE_PAGE_POOL_HELPERS
+#endif /* 6.6 */
+
+/*****************************************************************************/
+#if (KERNEL_VERSION(6, 7, 0) > LINUX_VERSION_CODE)
+#else
+#define HAVE_TCP_DATA_SPLIT_SET
+#endif /* 6.7 */
+
+/*****************************************************************************/
+#if (KERNEL_VERSION(6, 10, 0) > LINUX_VERSION_CODE)
+#define HAVE_XSK_BUFF_DMA_SYNC_POOL
+#else
+#endif /* 6.10 */
+
+/*****************************************************************************/
+#if (KERNEL_VERSION(6, 14, 0) > LINUX_VERSION_CODE)
+#else
+#define alloc_pages_bulk_array_node alloc_pages_bulk_node
+#endif /* 6.14 */
+
 /* We don't support PTP on older RHEL kernels (needs more compat work) */
 #if (RHEL_RELEASE_CODE && RHEL_RELEASE_CODE < RHEL_RELEASE_VERSION(7,4))
 #undef CONFIG_PTP_1588_CLOCK